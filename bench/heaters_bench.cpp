@@ -0,0 +1,327 @@
+#include "benchmark/benchmark.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "event_recorder.h"
+#include "heaters.h"
+#include "power_history.h"
+#include "recording_heaters.h"
+#include "alloc_counter.h"
+
+/**
+ * Замеры горячих путей модуля Heaters.
+ *
+ * Каждый замер параметризован количеством нагревателей (от 1 до 100000)
+ * и распределением мощностей. Кроме времени на операцию выводится
+ * количество выделений памяти на операцию (allocs/op).
+ */
+
+namespace {
+    /**
+     * Распределение мощностей нагревателей
+     */
+    enum Distribution {
+        /**
+         * Все нагреватели выключены
+         */
+        ALL_ZERO,
+        /**
+         * Все нагреватели на полной мощности
+         */
+        ALL_FULL,
+        /**
+         * Случайные мощности
+         */
+        RANDOM,
+        /**
+         * Случайные мощности, которые постоянно подстраиваются на несколько процентов
+         */
+        RETUNE
+    };
+
+    /**
+     * Приёмник, не делающий ничего: замеряется только сам модуль
+     */
+    class NullSink : public IHeatSink {
+    public:
+        void setStates(const HeatStateWord* states, const HeatStateWord* changed, std::size_t wordsCount) override {
+            benchmark::DoNotOptimize(states);
+            benchmark::DoNotOptimize(changed);
+            benchmark::DoNotOptimize(wordsCount);
+        }
+    };
+
+    /**
+     * Быстрый генератор псевдослучайных чисел (xorshift), чтобы не замерять std::rand
+     */
+    class Random {
+    public:
+        std::uint32_t next() {
+            _state ^= _state << 13;
+            _state ^= _state >> 17;
+            _state ^= _state << 5;
+
+            return _state;
+        }
+
+    private:
+        std::uint32_t _state = 2463534242u;
+    };
+
+    Power initialPower(Distribution distribution, Random& random) {
+        switch(distribution) {
+            case ALL_ZERO: return 0;
+            case ALL_FULL: return Heater::MAXIMUM_POWER;
+            default: return random.next() % (Heater::MAXIMUM_POWER + 1);
+        }
+    }
+
+    /**
+     * Следующая мощность нагревателя с мощностью current
+     */
+    Power nextPower(Distribution distribution, Power current, Random& random) {
+        if(distribution != RETUNE) return initialPower(distribution, random);
+
+        int power = static_cast<int>(current) + static_cast<int>(random.next() % 11) - 5;
+
+        if(power < 0) return 0;
+        if(power > Heater::MAXIMUM_POWER) return Heater::MAXIMUM_POWER;
+
+        return static_cast<Power>(power);
+    }
+
+    /**
+     * Модуль с мощностями по распределению, уже вступившими в силу
+     */
+    struct Bench {
+        Bench(HeaterNum heatersNum, Distribution distribution)
+                : heatersNum(heatersNum), distribution(distribution), heaters(heatersNum, sink) {
+            HeaterPowers powers;
+
+            for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+                powers.emplace_back(heater, initialPower(distribution, random));
+            }
+
+            heaters.setPowers(powers);
+            heaters.zeroCrossed();
+        }
+
+        /**
+         * Меняет мощность случайного нагревателя по распределению
+         */
+        void retune() {
+            HeaterNum heater = random.next() % heatersNum;
+
+            heaters.setPower(heater, nextPower(distribution, heaters.getPower(heater), random));
+        }
+
+        HeaterNum heatersNum;
+        Distribution distribution;
+        Random random;
+        NullSink sink;
+        Heaters heaters;
+    };
+
+    /**
+     * Выводит количество выделений памяти на операцию
+     */
+    class AllocationCounter {
+    public:
+        explicit AllocationCounter(benchmark::State& state)
+                : _state(state), _start(getAllocationsCount()) {
+        }
+
+        ~AllocationCounter() {
+            double count = static_cast<double>(getAllocationsCount() - _start);
+
+            _state.counters["allocs/op"] = benchmark::Counter(count, benchmark::Counter::kAvgIterations);
+        }
+
+    private:
+        benchmark::State& _state;
+        std::size_t _start;
+    };
+
+    HeaterNum heatersNum(const benchmark::State& state) {
+        return static_cast<HeaterNum>(state.range(0));
+    }
+
+    Distribution distribution(const benchmark::State& state) {
+        return static_cast<Distribution>(state.range(1));
+    }
+}
+
+/**
+ * Один полупериод; при RETUNE перед каждым полупериодом меняется мощность одного нагревателя
+ */
+static void BM_ZeroCrossed(benchmark::State& state) {
+    Bench bench(heatersNum(state), distribution(state));
+    bool retune = bench.distribution == RETUNE;
+    AllocationCounter counter(state);
+
+    for(auto _ : state) {
+        if(retune) bench.retune();
+
+        bench.heaters.zeroCrossed();
+    }
+}
+
+/**
+ * Одна секунда (100 полупериодов, включая ежесекундное обновление истории)
+ */
+static void BM_Second(benchmark::State& state) {
+    Bench bench(heatersNum(state), distribution(state));
+    AllocationCounter counter(state);
+
+    for(auto _ : state) {
+        for(int frame = 0; frame < 100; ++frame) {
+            bench.heaters.zeroCrossed();
+        }
+    }
+}
+
+/**
+ * Ежесекундное обновление истории мощностей всех нагревателей
+ */
+static void BM_HistoryUpdate(benchmark::State& state) {
+    HeaterNum heaters = heatersNum(state);
+    Distribution powers = distribution(state);
+    PowerHistory history(heaters);
+    Random random;
+    AllocationCounter counter(state);
+
+    for(auto _ : state) {
+        history.roll();
+
+        for(HeaterNum heater = 0; heater < heaters; ++heater) {
+            history.record(heater, initialPower(powers, random));
+        }
+    }
+}
+
+static void BM_SetPower(benchmark::State& state) {
+    Bench bench(heatersNum(state), distribution(state));
+    AllocationCounter counter(state);
+
+    for(auto _ : state) {
+        bench.retune();
+    }
+}
+
+static void BM_MaxNumOfTurnedHeatersAfterPowerChange(benchmark::State& state) {
+    Bench bench(heatersNum(state), distribution(state));
+    AllocationCounter counter(state);
+    unsigned int top = 0;
+    unsigned int bot = 0;
+
+    for(auto _ : state) {
+        HeaterNum heater = bench.random.next() % bench.heatersNum;
+        Power power = nextPower(bench.distribution, bench.heaters.getPower(heater), bench.random);
+
+        bench.heaters.getMaxNumOfTurnedHeatersAfterPowerChange(heater, power, top, bot);
+        benchmark::DoNotOptimize(top);
+        benchmark::DoNotOptimize(bot);
+    }
+}
+
+/**
+ * Пакет из 256 кандидатов по одной общей схеме
+ */
+static void BM_MaxNumOfTurnedHeatersAfterPowerChanges(benchmark::State& state) {
+    Bench bench(heatersNum(state), distribution(state));
+    HeaterPowers candidates;
+    std::vector<std::pair<HeaterNum, HeaterNum>> peaks;
+
+    for(int candidate = 0; candidate < 256; ++candidate) {
+        HeaterNum heater = bench.random.next() % bench.heatersNum;
+
+        candidates.emplace_back(heater, nextPower(bench.distribution, bench.heaters.getPower(heater), bench.random));
+    }
+
+    AllocationCounter counter(state);
+
+    for(auto _ : state) {
+        bench.heaters.getMaxNumOfTurnedHeatersAfterPowerChanges(candidates, peaks);
+        benchmark::DoNotOptimize(peaks.data());
+    }
+
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(candidates.size()));
+}
+
+/**
+ * Воспроизведение записи 10 секунд работы (мощность одного нагревателя меняется
+ * в каждом полупериоде) со сверкой контрольных точек, включая создание модуля
+ */
+static void BM_Replay(benchmark::State& state) {
+    HeaterNum heaters = heatersNum(state);
+    Distribution powers = distribution(state);
+    NullSink sink;
+    RecordingHeaters recording(heaters, sink, RecordingHeaters::DEFAULT_RECORD_CAPACITY * 16);
+    Random random;
+    HeaterPowers initial;
+
+    for(HeaterNum heater = 0; heater < heaters; ++heater) {
+        initial.emplace_back(heater, initialPower(powers, random));
+    }
+
+    recording.setPowers(initial);
+
+    for(int frame = 0; frame < 1000; ++frame) {
+        HeaterNum heater = random.next() % heaters;
+
+        recording.setPower(heater, nextPower(powers, recording.getPower(heater), random));
+        recording.zeroCrossed();
+    }
+
+    EventRecorder& recorder = recording.getRecorder();
+    recorder.flush();
+
+    for(auto _ : state) {
+        ReplayReport report = replayRecording(recorder.getData(), recorder.getSize(), &sink);
+
+        if(!report.valid || report.mismatches) state.SkipWithError("replay diverged from recording");
+    }
+
+    state.SetItemsProcessed(state.iterations() * 1000);
+    state.counters["bytes"] = static_cast<double>(recorder.getSize());
+}
+
+/**
+ * Количество нагревателей x распределение мощностей
+ */
+static void heatersAndDistributions(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"heaters", "distribution"});
+
+    for(long heaters: {1, 10, 100, 1000, 10000, 100000}) {
+        for(long powers: {ALL_ZERO, ALL_FULL, RANDOM, RETUNE}) {
+            bench->Args({heaters, powers});
+        }
+    }
+}
+
+/**
+ * То же до 10000 нагревателей: запись в 1000 полупериодов с перестроением схемы
+ * в каждом из них на 100000 нагревателях воспроизводится минутами
+ */
+static void replayHeatersAndDistributions(benchmark::internal::Benchmark* bench) {
+    bench->ArgNames({"heaters", "distribution"});
+
+    for(long heaters: {1, 10, 100, 1000, 10000}) {
+        for(long powers: {ALL_ZERO, ALL_FULL, RANDOM, RETUNE}) {
+            bench->Args({heaters, powers});
+        }
+    }
+}
+
+BENCHMARK(BM_ZeroCrossed)->Apply(heatersAndDistributions);
+BENCHMARK(BM_Second)->Apply(heatersAndDistributions);
+BENCHMARK(BM_HistoryUpdate)->Apply(heatersAndDistributions);
+BENCHMARK(BM_SetPower)->Apply(heatersAndDistributions);
+BENCHMARK(BM_MaxNumOfTurnedHeatersAfterPowerChange)->Apply(heatersAndDistributions);
+BENCHMARK(BM_MaxNumOfTurnedHeatersAfterPowerChanges)->Apply(heatersAndDistributions);
+BENCHMARK(BM_Replay)->Apply(replayHeatersAndDistributions);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,58 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "event_recorder.h"
+
+/**
+ * Воспроизводит запись вызовов модуля Heaters (см. EventRecorder) с максимальной скоростью.
+ *
+ * Сверяет состояния и историю мощностей с контрольными точками записи
+ * и выводит скорость воспроизведения.
+ *
+ * Использование: heaters_replay <файл записи>
+ * Код возврата: 0 - воспроизведение совпало с записью, 1 - расхождение, 2 - ошибка записи
+ */
+int main(int argc, char** argv) {
+    if(argc != 2) {
+        std::fprintf(stderr, "usage: %s <recording>\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<unsigned char> data;
+
+    if(!loadRecording(argv[1], data)) {
+        std::fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 2;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ReplayReport report = replayRecording(data.data(), data.size());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = elapsed.count() > 0 ? elapsed.count() : 1e-9;
+
+    std::printf("events: %llu, frames: %llu, checkpoints: %llu, bytes: %zu\n",
+                static_cast<unsigned long long>(report.events),
+                static_cast<unsigned long long>(report.frames),
+                static_cast<unsigned long long>(report.checkpoints), data.size());
+    std::printf("elapsed: %.6f s, %.0f frames/s, %.0f events/s\n",
+                seconds, static_cast<double>(report.frames) / seconds,
+                static_cast<double>(report.events) / seconds);
+
+    if(!report.valid) {
+        std::printf("malformed recording at offset %zu\n", report.errorOffset);
+        return 2;
+    }
+
+    if(report.mismatches) {
+        std::printf("mismatched checkpoints: %llu, first at frame %llu\n",
+                    static_cast<unsigned long long>(report.mismatches),
+                    static_cast<unsigned long long>(report.firstMismatchFrame));
+        return 1;
+    }
+
+    std::printf("replay matches recording\n");
+
+    return 0;
+}
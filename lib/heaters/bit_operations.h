@@ -0,0 +1,64 @@
+#ifndef HEATERS_BIT_OPERATIONS_H
+#define HEATERS_BIT_OPERATIONS_H
+
+#include <cstdint>
+
+/**
+ * Количество единичных бит в слове
+ *
+ * @note На GCC/Clang компилируется в инструкцию popcnt (при -mpopcnt/-march=native),
+ *       циклы по словам при этом векторизуются компилятором
+ */
+inline unsigned popCount(std::uint64_t word) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_popcountll(word));
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+
+    return static_cast<unsigned>((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+/**
+ * Номер младшего единичного бита слова
+ *
+ * @note word не должно быть нулём
+ */
+inline unsigned countTrailingZeros(std::uint64_t word) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#else
+    unsigned count = 0;
+
+    while((word & 1u) == 0) {
+        word >>= 1;
+        ++count;
+    }
+
+    return count;
+#endif
+}
+
+/**
+ * Количество нулевых бит слова перед старшим единичным
+ *
+ * @note word не должно быть нулём
+ */
+inline unsigned countLeadingZeros(std::uint64_t word) {
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_clzll(word));
+#else
+    unsigned count = 0;
+
+    while((word & (1ull << 63)) == 0) {
+        word <<= 1;
+        ++count;
+    }
+
+    return count;
+#endif
+}
+
+#endif //HEATERS_BIT_OPERATIONS_H
@@ -0,0 +1,164 @@
+#ifndef HEATERS_COMMAND_QUEUE_H
+#define HEATERS_COMMAND_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Ограниченная очередь команд без блокировок для многих писателей и одного читателя.
+ *
+ * Кольцо ячеек с порядковыми номерами (схема Д. Вьюкова): писатель захватывает
+ * подряд идущие ячейки одним CAS позиции записи и публикует каждую ячейку
+ * своим порядковым номером, читатель забирает ячейки строго по порядку.
+ * Память выделяется только в конструкторе.
+ *
+ * @tparam Command - тип команды (копируемый)
+ */
+template<typename Command>
+class CommandQueue {
+public:
+    /**
+     * @param capacity - ёмкость очереди (округляется вверх до степени двойки)
+     */
+    explicit CommandQueue(std::size_t capacity);
+
+    /**
+     * Добавляет count команд в очередь подряд.
+     *
+     * @note Вызывается из любого потока
+     *
+     * @return false, если в очереди нет места под все команды (ничего не добавлено)
+     */
+    bool push(const Command* commands, std::size_t count = 1);
+
+    /**
+     * Добавляет count команд в очередь подряд, создавая их прямо в ячейках очереди
+     *
+     * @note Вызывается из любого потока
+     *
+     * @param make - make(i) возвращает i-ю команду
+     *
+     * @return false, если в очереди нет места под все команды (ничего не добавлено)
+     */
+    template<typename Make>
+    bool pushEach(std::size_t count, Make&& make);
+
+    /**
+     * Возвращает команду со смещением offset от начала очереди
+     * или nullptr, если она ещё не опубликована.
+     *
+     * @note Вызывается только из потока-читателя
+     */
+    const Command* front(std::size_t offset = 0) const;
+
+    /**
+     * Освобождает count команд с начала очереди
+     *
+     * @note Вызывается только из потока-читателя
+     */
+    void pop(std::size_t count = 1);
+
+    std::size_t getCapacity() const;
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        Command command;
+    };
+
+    /**
+     * Размер строки кэша, чтобы позиции писателей и читателя не делили одну строку
+     */
+    static const std::size_t CACHE_LINE = 64;
+
+private:
+    std::size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+
+    char _enqueuePadding[CACHE_LINE];
+    std::atomic<std::size_t> _enqueuePos{0};
+    char _dequeuePadding[CACHE_LINE];
+    std::size_t _dequeuePos = 0;
+};
+
+template<typename Command>
+CommandQueue<Command>::CommandQueue(std::size_t capacity) {
+    std::size_t size = 1;
+
+    while(size < capacity) size <<= 1;
+
+    _mask = size - 1;
+    _cells.reset(new Cell[size]);
+
+    for(std::size_t i = 0; i < size; ++i) {
+        _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+template<typename Command>
+bool CommandQueue<Command>::push(const Command* commands, std::size_t count) {
+    return pushEach(count, [commands](std::size_t i) { return commands[i]; });
+}
+
+template<typename Command>
+template<typename Make>
+bool CommandQueue<Command>::pushEach(std::size_t count, Make&& make) {
+    if(count == 0) return true;
+    if(count > getCapacity()) return false;
+
+    std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+    for(;;) {
+        // Читатель освобождает ячейки по порядку, поэтому достаточно проверить последнюю
+        std::size_t last = pos + count - 1;
+        std::size_t sequence = _cells[last & _mask].sequence.load(std::memory_order_acquire);
+        std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(last);
+
+        if(diff == 0) {
+            if(_enqueuePos.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed)) break;
+        } else if(diff < 0) {
+            return false;
+        } else {
+            pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    for(std::size_t i = 0; i < count; ++i) {
+        Cell& cell = _cells[(pos + i) & _mask];
+
+        cell.command = make(i);
+        cell.sequence.store(pos + i + 1, std::memory_order_release);
+    }
+
+    return true;
+}
+
+template<typename Command>
+const Command* CommandQueue<Command>::front(std::size_t offset) const {
+    std::size_t pos = _dequeuePos + offset;
+    const Cell& cell = _cells[pos & _mask];
+
+    if(cell.sequence.load(std::memory_order_acquire) != pos + 1) return nullptr;
+
+    return &cell.command;
+}
+
+template<typename Command>
+void CommandQueue<Command>::pop(std::size_t count) {
+    for(std::size_t i = 0; i < count; ++i) {
+        std::size_t pos = _dequeuePos + i;
+
+        _cells[pos & _mask].sequence.store(pos + _mask + 1, std::memory_order_release);
+    }
+
+    _dequeuePos += count;
+}
+
+template<typename Command>
+std::size_t CommandQueue<Command>::getCapacity() const {
+    return _mask + 1;
+}
+
+#endif //HEATERS_COMMAND_QUEUE_H
@@ -0,0 +1,331 @@
+#include "concurrent_heaters.h"
+
+#include <algorithm>
+#include <thread>
+
+#include "heat_setter_sink.h"
+#include "power_history.h"
+
+ConcurrentHeaters::StatesSink::StatesSink(ConcurrentHeaters& owner) : _owner(owner) {
+}
+
+void ConcurrentHeaters::StatesSink::setStates(const HeatStateWord* states, const HeatStateWord* changed,
+                                              std::size_t wordsCount) {
+    _owner._sink->setStates(states, changed, wordsCount);
+    _owner._stageStates(states, changed, nullptr, wordsCount);
+}
+
+void ConcurrentHeaters::StatesSink::setActiveStates(const HeatStateWord* states, const HeatStateWord* changed,
+                                                    std::size_t wordsCount,
+                                                    const HeaterNum* activeWords, std::size_t activeCount) {
+    _owner._sink->setActiveStates(states, changed, wordsCount, activeWords, activeCount);
+    _owner._stageStates(states, changed, activeWords, activeCount);
+}
+
+ConcurrentHeaters::ConcurrentHeaters(HeaterNum heatersNum, HeatSetter setHeaterStateFn,
+                                     std::size_t commandCapacity, ScheduleLayout layout)
+        : ConcurrentHeaters(heatersNum, nullptr,
+                            std::make_unique<HeatSetterSink>(heatersNum, std::move(setHeaterStateFn)),
+                            commandCapacity, layout) {
+}
+
+ConcurrentHeaters::ConcurrentHeaters(HeaterNum heatersNum, IHeatSink& sink,
+                                     std::size_t commandCapacity, ScheduleLayout layout)
+        : ConcurrentHeaters(heatersNum, &sink, nullptr, commandCapacity, layout) {
+}
+
+ConcurrentHeaters::ConcurrentHeaters(HeaterNum heatersNum, IHeatSink* sink, std::unique_ptr<IHeatSink> ownedSink,
+                                     std::size_t commandCapacity, ScheduleLayout layout)
+        : _heatersNum(heatersNum),
+          _wordsCount((heatersNum + HEAT_STATE_WORD_BITS - 1) / HEAT_STATE_WORD_BITS),
+          _ownedSink(std::move(ownedSink)), _sink(sink ? sink : _ownedSink.get()),
+          _statesSink(*this),
+          _heaters(heatersNum, _statesSink, layout),
+          _commands(commandCapacity),
+          _isBatchHeater(heatersNum, 0),
+          _isStagedPower(heatersNum, 0),
+          _stagedStates(_wordsCount, 0),
+          _powers(heatersNum),
+          _powerLog(POWER_LOG_SIZE),
+          _lastStates(_wordsCount),
+          _history(static_cast<std::size_t>(PowerHistory::TIME_LIMIT) * heatersNum),
+          _historySeconds(static_cast<std::size_t>(PowerHistory::TIME_LIMIT) * _wordsCount),
+          _isSecondWord(_wordsCount, 0),
+          _schedule(heatersNum, _heaters.getFrameCount(), layout) {
+    _batch.reserve(_commands.getCapacity());
+    _batchHeaters.reserve(heatersNum);
+    _stagedPowers.reserve(heatersNum);
+    _stagedWords.reserve(_wordsCount);
+    _statesWords.reserve(_wordsCount);
+    _secondWords.reserve(_wordsCount);
+    _scheduleChanges.reserve(heatersNum);
+}
+
+void ConcurrentHeaters::setPower(HeaterNum heater, Power power) {
+    if(heater >= _heatersNum || power > Heater::MAXIMUM_POWER) return;
+
+    while(!trySetPower(heater, power)) {
+        std::this_thread::yield();
+    }
+}
+
+bool ConcurrentHeaters::trySetPower(HeaterNum heater, Power power) {
+    if(heater >= _heatersNum || power > Heater::MAXIMUM_POWER) return false;
+
+    PowerCommand command = {SINGLE, heater, power, PowersCommit::NEXT_FRAME};
+
+    return _commands.push(&command);
+}
+
+bool ConcurrentHeaters::setPowers(const HeaterPowers& powers, PowersCommit commit) {
+    if(powers.empty()) return true;
+    if(powers.size() + 1 > _commands.getCapacity()) return false;
+
+    for(const auto& heaterAndPower: powers) {
+        if(heaterAndPower.first >= _heatersNum || heaterAndPower.second > Heater::MAXIMUM_POWER) {
+            return false;
+        }
+    }
+
+    // Заголовок и команды набора занимают подряд идущие ячейки очереди
+    return _commands.pushEach(powers.size() + 1, [&powers, commit](std::size_t i) -> PowerCommand {
+        if(i == 0) return {static_cast<HeaterNum>(powers.size()), 0, 0, commit};
+
+        return {0, powers[i - 1].first, powers[i - 1].second, commit};
+    });
+}
+
+void ConcurrentHeaters::getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum heater, Power power,
+                                                                 unsigned int& top, unsigned int& bot) {
+    std::lock_guard<std::mutex> lock(_scheduleMutex);
+
+    _refreshSchedule();
+
+    std::pair<HeaterNum, HeaterNum> evenOddHeaters;
+
+    if(heater >= _heatersNum) {
+        evenOddHeaters = _schedule.getMaximumEvenOddHeaters();
+    } else {
+        if(power > Heater::MAXIMUM_POWER) {
+            power = _schedule.getPower(heater);
+        }
+
+        evenOddHeaters = _schedule.getMaximumEvenOddHeatersAfterPowerChange(heater, power);
+    }
+
+    top = evenOddHeaters.first;
+    bot = evenOddHeaters.second;
+}
+
+Power ConcurrentHeaters::getPower(HeaterNum heater, unsigned short timeOffset) {
+    if(heater >= _heatersNum || timeOffset >= PowerHistory::TIME_LIMIT) return 0;
+
+    return _seqLock.read([this, heater, timeOffset]() -> Power {
+        std::uint32_t now = _second.load(std::memory_order_relaxed);
+
+        if(timeOffset >= now) return 0;
+
+        // Столбец хранит эту секунду, только если слово нагревателя было в ней активно
+        std::uint32_t second = now - timeOffset;
+        std::size_t column = second % PowerHistory::TIME_LIMIT;
+        HeaterNum word = heater / HEAT_STATE_WORD_BITS;
+
+        if(_historySeconds[column * _wordsCount + word].load(std::memory_order_relaxed) != second) return 0;
+
+        return _history[column * _heatersNum + heater].load(std::memory_order_relaxed);
+    });
+}
+
+bool ConcurrentHeaters::getLastSemiPeriodState(HeaterNum heaterNum) {
+    if(heaterNum >= _heatersNum) return false;
+
+    HeatStateWord lastStates = _seqLock.read([this, heaterNum]() {
+        return _lastStates[heaterNum / HEAT_STATE_WORD_BITS].load(std::memory_order_relaxed);
+    });
+
+    return (lastStates >> (heaterNum % HEAT_STATE_WORD_BITS)) & 1u;
+}
+
+void ConcurrentHeaters::zeroCrossed() {
+    Frame frame = _heaters.getCurrentFrame();
+
+    _applyCommands();
+    _heaters.zeroCrossed();
+
+    // Набор вступает в силу в этом полупериоде или в начале секунды (см. Heaters::setPowers)
+    if(_batchPending && (_pendingCommit == PowersCommit::NEXT_FRAME || frame == 0)) {
+        for(HeaterNum heater: _batchHeaters) {
+            _isBatchHeater[heater] = false;
+            _stagePower(heater);
+        }
+
+        _batchHeaters.clear();
+        _batchPending = false;
+    }
+
+    // Полупериод выполнен вне seqlock, под ним публикуются только накопленные изменения
+    _seqLock.beginWrite();
+
+    for(HeaterNum heater: _stagedPowers) {
+        _isStagedPower[heater] = false;
+        _publishPower(heater);
+    }
+
+    _stagedPowers.clear();
+
+    if(_statesStaged) _publishStates();
+    if(_heaters.getCurrentFrame() == 0) _publishSecond();
+
+    _seqLock.endWrite();
+}
+
+HeatersMetricsSnapshot ConcurrentHeaters::getMetrics() const {
+    return _heaters.getMetrics();
+}
+
+void ConcurrentHeaters::_applyCommands() {
+    while(const PowerCommand* command = _commands.front()) {
+        if(command->batchSize == SINGLE) {
+            _heaters.setPower(command->heater, command->power);
+            _stagePower(command->heater);
+            _commands.pop();
+            continue;
+        }
+
+        HeaterNum batchSize = command->batchSize;
+
+        // Набор применяется, только когда опубликованы все его команды
+        if(!_commands.front(batchSize)) break;
+
+        _batch.clear();
+
+        for(HeaterNum i = 1; i <= batchSize; ++i) {
+            const PowerCommand* entry = _commands.front(i);
+
+            _batch.emplace_back(entry->heater, entry->power);
+
+            if(!_isBatchHeater[entry->heater]) {
+                _isBatchHeater[entry->heater] = true;
+                _batchHeaters.push_back(entry->heater);
+            }
+        }
+
+        _heaters.setPowers(_batch, command->commit);
+        _batchPending = true;
+        _pendingCommit = command->commit;
+
+        _commands.pop(batchSize + 1);
+    }
+}
+
+void ConcurrentHeaters::_stagePower(HeaterNum heater) {
+    if(_isStagedPower[heater]) return;
+
+    _isStagedPower[heater] = true;
+    _stagedPowers.push_back(heater);
+}
+
+void ConcurrentHeaters::_stageStates(const HeatStateWord* states, const HeatStateWord* changed,
+                                     const HeaterNum* words, std::size_t count) {
+    _stagedWords.clear();
+
+    for(std::size_t i = 0; i < count; ++i) {
+        HeaterNum word = words ? words[i] : static_cast<HeaterNum>(i);
+
+        // Состояние до последнего полупериода - текущее состояние с отменённым изменением
+        _stagedStates[word] = states[word] ^ changed[word];
+        _stagedWords.push_back(word);
+
+        if(!_isSecondWord[word]) {
+            _isSecondWord[word] = true;
+            _secondWords.push_back(word);
+        }
+    }
+
+    _statesStaged = true;
+}
+
+void ConcurrentHeaters::_publishPower(HeaterNum heater) {
+    unsigned char power = static_cast<unsigned char>(_heaters.getScheduledPower(heater));
+
+    if(_powers[heater].load(std::memory_order_relaxed) == power) return;
+
+    std::uint32_t version = _powersVersion.load(std::memory_order_relaxed) + 1;
+
+    _powers[heater].store(power, std::memory_order_relaxed);
+    _powerLog[version % POWER_LOG_SIZE].store(heater, std::memory_order_relaxed);
+    _powersVersion.store(version, std::memory_order_relaxed);
+}
+
+void ConcurrentHeaters::_publishStates() {
+    // Слово исключается из активных, когда его состояния нулевые, но прошлые могли быть опубликованы
+    for(HeaterNum word: _statesWords) {
+        _lastStates[word].store(0, std::memory_order_relaxed);
+    }
+
+    _statesWords.clear();
+
+    for(HeaterNum word: _stagedWords) {
+        _lastStates[word].store(_stagedStates[word], std::memory_order_relaxed);
+        _statesWords.push_back(word);
+    }
+
+    _statesStaged = false;
+}
+
+void ConcurrentHeaters::_publishSecond() {
+    std::uint32_t second = _second.load(std::memory_order_relaxed) + 1;
+    std::size_t column = second % PowerHistory::TIME_LIMIT;
+
+    // Мощность за секунду ненулевая, только если нагреватель включался, т.е. его слово было активным
+    for(HeaterNum word: _secondWords) {
+        HeaterNum first = word * HEAT_STATE_WORD_BITS;
+        HeaterNum last = std::min<HeaterNum>(first + HEAT_STATE_WORD_BITS, _heatersNum);
+
+        for(HeaterNum heater = first; heater < last; ++heater) {
+            _history[column * _heatersNum + heater].store(static_cast<unsigned char>(_heaters.getPower(heater)),
+                                                          std::memory_order_relaxed);
+        }
+
+        _historySeconds[column * _wordsCount + word].store(second, std::memory_order_relaxed);
+        _isSecondWord[word] = false;
+    }
+
+    _secondWords.clear();
+    _second.store(second, std::memory_order_relaxed);
+}
+
+void ConcurrentHeaters::_refreshSchedule() {
+    std::uint32_t version = _seqLock.read([this]() {
+        std::uint32_t readVersion = _powersVersion.load(std::memory_order_relaxed);
+
+        // Неудачное чтение повторяется целиком, поэтому изменения можно собирать на месте
+        _scheduleChanges.clear();
+
+        if(readVersion == _scheduleVersion) return readVersion;
+
+        if(readVersion - _scheduleVersion <= POWER_LOG_SIZE) {
+            for(std::uint32_t logged = _scheduleVersion + 1; logged != readVersion + 1; ++logged) {
+                HeaterNum heater = _powerLog[logged % POWER_LOG_SIZE].load(std::memory_order_relaxed);
+
+                _scheduleChanges.emplace_back(heater, _powers[heater].load(std::memory_order_relaxed));
+            }
+
+            return readVersion;
+        }
+
+        // Журнал перезаписан: сверяем все мощности
+        for(HeaterNum heater = 0; heater < _heatersNum; ++heater) {
+            Power power = _powers[heater].load(std::memory_order_relaxed);
+
+            if(power != _schedule.getPower(heater)) _scheduleChanges.emplace_back(heater, power);
+        }
+
+        return readVersion;
+    });
+
+    if(version == _scheduleVersion) return;
+
+    _scheduleVersion = version;
+    _schedule.setPowers(_scheduleChanges);
+}
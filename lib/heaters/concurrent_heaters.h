@@ -0,0 +1,295 @@
+#ifndef HEATERS_CONCURRENT_HEATERS_H
+#define HEATERS_CONCURRENT_HEATERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "variables_description.h"
+#include "command_queue.h"
+#include "heat_schedule.h"
+#include "heat_sink.h"
+#include "heaters.h"
+#include "seq_lock.h"
+
+/**
+ * Потокобезопасный фасад модуля Heaters.
+ *
+ * Потоки управления не изменяют схему нагревания сами, а ставят команды
+ * в очередь без блокировок (CommandQueue). Поток перехода через ноль в zeroCrossed()
+ * забирает накопленные команды, применяет их и выполняет полупериод - без блокировок
+ * и без выделения памяти.
+ *
+ * Другие потоки не читают Heaters: поток перехода через ноль публикует под seqlock
+ * снимок из атомарных переменных - мощности схемы, состояния прошлого полупериода
+ * и историю мощностей за PowerHistory::TIME_LIMIT секунд. Полупериод (вместе с вызовами
+ * приёмника пользователя) выполняется вне seqlock: изменения снимка накапливаются
+ * и публикуются после него короткой записью - O(изменений). Поток перехода через ноль
+ * никогда не ждёт читателей, а читатель повторяет чтение, если оно пересеклось с публикацией.
+ *
+ * Публикация ленивая, как и сама история: состояния обновляются только в активных словах
+ * (см. IHeatSink::setActiveStates), а секунда истории - только в словах, активных в эту секунду.
+ * Каждое слово секунды помечается её номером, поэтому непомеченные слова читаются нулевыми.
+ * Снимок занимает около 700 байт на нагреватель (в основном - столбцы истории).
+ *
+ * Пики считаются по копии схемы в памяти читателей. Каждая публикация мощности
+ * записывается в кольцевой журнал изменений, и копия догоняет снимок только
+ * по изменённым нагревателям (см. HeatSchedule::setPowers); полностью она сверяется
+ * со снимком, только если отстала больше, чем на журнал. Копия общая для читателей
+ * и защищена мьютексом, который берут только читатели.
+ */
+class ConcurrentHeaters : public IHeaters {
+public:
+    /**
+     * Ёмкость очереди команд по умолчанию
+     */
+    static const std::size_t DEFAULT_COMMAND_CAPACITY = 1024;
+
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param setHeaterStateFn - функция для установки состояния нагревателя
+     * 		  (вызывается из потока перехода через ноль)
+     *
+     * @param commandCapacity - ёмкость очереди команд
+     *
+     * @param layout - способ раскладки нагревателей по полупериодам
+     */
+    ConcurrentHeaters(HeaterNum heatersNum,
+                      HeatSetter setHeaterStateFn,
+                      std::size_t commandCapacity = DEFAULT_COMMAND_CAPACITY,
+                      ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param sink - приёмник упакованных состояний (вызывается из потока перехода через ноль)
+     *
+     * @param commandCapacity - ёмкость очереди команд
+     *
+     * @param layout - способ раскладки нагревателей по полупериодам
+     */
+    ConcurrentHeaters(HeaterNum heatersNum,
+                      IHeatSink& sink,
+                      std::size_t commandCapacity = DEFAULT_COMMAND_CAPACITY,
+                      ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    /**
+     * Ставит установку мощности в очередь
+     *
+     * @note Мощность вступает в силу в ближайшем вызове zeroCrossed().
+     *       Если очередь заполнена, ждёт освобождения места.
+     */
+    void setPower(HeaterNum heater, Power power) override;
+
+    /**
+     * Ставит установку мощности в очередь, не дожидаясь освобождения места
+     *
+     * @return false, если мощность некорректна или очередь заполнена
+     */
+    bool trySetPower(HeaterNum heater, Power power);
+
+    /**
+     * Ставит набор мощностей в очередь одной транзакцией
+     *
+     * @note Набор применяется в zeroCrossed() целиком, см. Heaters::setPowers
+     *
+     * @return false, если набор некорректен или не помещается в очередь
+     */
+    bool setPowers(const HeaterPowers& powers, PowersCommit commit = PowersCommit::NEXT_FRAME) override;
+
+    void getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum heater, Power power,
+                                                  unsigned int& top, unsigned int& bot) override;
+
+    Power getPower(HeaterNum heater, unsigned short timeOffset = 0) override;
+
+    bool getLastSemiPeriodState(HeaterNum heaterNum) override;
+
+    /**
+     * Информирует модуль о переходе через ноль
+     *
+     * @note Вызывается только из одного потока (потока перехода через ноль)
+     */
+    void zeroCrossed();
+
+    /**
+     * Возвращает снимок встроенных замеров, см. Heaters::getMetrics
+     *
+     * @note Замеры читаются без seqlock
+     */
+    HeatersMetricsSnapshot getMetrics() const;
+
+private:
+    /**
+     * Приёмник, через который Heaters передаёт состояния: публикует их в снимок
+     * и передаёт приёмнику пользователя
+     */
+    class StatesSink : public IHeatSink {
+    public:
+        explicit StatesSink(ConcurrentHeaters& owner);
+
+        void setStates(const HeatStateWord* states, const HeatStateWord* changed,
+                       std::size_t wordsCount) override;
+
+        void setActiveStates(const HeatStateWord* states, const HeatStateWord* changed, std::size_t wordsCount,
+                             const HeaterNum* activeWords, std::size_t activeCount) override;
+
+    private:
+        ConcurrentHeaters& _owner;
+    };
+
+    struct PowerCommand {
+        /**
+         * Для заголовка набора - количество следующих за ним команд набора,
+         * для одиночной команды - SINGLE
+         */
+        HeaterNum batchSize;
+        HeaterNum heater;
+        Power power;
+        PowersCommit commit;
+    };
+
+    static const HeaterNum SINGLE = static_cast<HeaterNum>(-1);
+
+    /**
+     * Размер журнала изменений мощностей
+     */
+    static const std::size_t POWER_LOG_SIZE = 256;
+
+private:
+    ConcurrentHeaters(HeaterNum heatersNum, IHeatSink* sink, std::unique_ptr<IHeatSink> ownedSink,
+                      std::size_t commandCapacity, ScheduleLayout layout);
+
+    /**
+     * Применяет накопленные команды
+     */
+    void _applyCommands();
+
+    /**
+     * Отмечает нагреватель, мощность которого нужно опубликовать
+     */
+    void _stagePower(HeaterNum heater);
+
+    /**
+     * Запоминает состояния прошлого полупериода слов words (count слов, nullptr - все слова)
+     * для публикации после полупериода
+     */
+    void _stageStates(const HeatStateWord* states, const HeatStateWord* changed,
+                      const HeaterNum* words, std::size_t count);
+
+    /**
+     * Публикует мощность нагревателя в действующей схеме
+     *
+     * @note Вызывается под seqlock
+     */
+    void _publishPower(HeaterNum heater);
+
+    /**
+     * Публикует запомненные состояния прошлого полупериода
+     *
+     * @note Вызывается под seqlock
+     */
+    void _publishStates();
+
+    /**
+     * Публикует завершённую секунду истории для слов, активных в эту секунду
+     *
+     * @note Вызывается под seqlock
+     */
+    void _publishSecond();
+
+    /**
+     * Применяет к копии схемы читателей изменения опубликованных мощностей
+     *
+     * @note Вызывается под _scheduleMutex
+     */
+    void _refreshSchedule();
+
+private:
+    HeaterNum _heatersNum;
+    HeaterNum _wordsCount;
+    std::unique_ptr<IHeatSink> _ownedSink;
+    IHeatSink* _sink;
+    StatesSink _statesSink;
+    Heaters _heaters;
+    CommandQueue<PowerCommand> _commands;
+    SeqLock _seqLock;
+    /**
+     * Набор мощностей, собираемый из очереди (память выделена в конструкторе)
+     */
+    HeaterPowers _batch;
+    /**
+     * Применён набор мощностей, ещё не вступивший в силу, и способ его вступления
+     */
+    bool _batchPending = false;
+    PowersCommit _pendingCommit = PowersCommit::NEXT_FRAME;
+    /**
+     * Нагреватели ещё не вступивших в силу наборов
+     */
+    std::vector<HeaterNum> _batchHeaters;
+    std::vector<unsigned char> _isBatchHeater;
+
+    /**
+     * Изменения снимка, накопленные за полупериод (только для потока перехода через ноль,
+     * память выделена в конструкторе): нагреватели с изменёнными мощностями
+     * и состояния прошлого полупериода _stagedStates[word] слов _stagedWords
+     */
+    std::vector<HeaterNum> _stagedPowers;
+    std::vector<unsigned char> _isStagedPower;
+    std::vector<HeatStateWord> _stagedStates;
+    std::vector<HeaterNum> _stagedWords;
+    bool _statesStaged = false;
+
+    /**
+     * Снимок для читателей (пишется только потоком перехода через ноль под seqlock)
+     */
+    std::vector<std::atomic<unsigned char>> _powers;
+    /**
+     * Увеличивается при каждом изменении опубликованной мощности
+     */
+    std::atomic<std::uint32_t> _powersVersion{0};
+    /**
+     * _powerLog[version % POWER_LOG_SIZE] - нагреватель, изменение мощности которого
+     * увеличило версию до version
+     */
+    std::vector<std::atomic<HeaterNum>> _powerLog;
+    /**
+     * Состояния прошлого полупериода (см. Heaters::getLastSemiPeriodState)
+     */
+    std::vector<std::atomic<HeatStateWord>> _lastStates;
+    /**
+     * Номер последней завершённой секунды (как PowerHistory::getEpoch)
+     */
+    std::atomic<std::uint32_t> _second{0};
+    /**
+     * _history[second % TIME_LIMIT * _heatersNum + heater] - мощность за секунду second
+     */
+    std::vector<std::atomic<unsigned char>> _history;
+    /**
+     * _historySeconds[second % TIME_LIMIT * _wordsCount + word] - номер секунды,
+     * записанной в столбец для слова word
+     */
+    std::vector<std::atomic<std::uint32_t>> _historySeconds;
+
+    /**
+     * Слова с опубликованными состояниями и слова, активные в текущей секунде
+     * (только для потока перехода через ноль, память выделена в конструкторе)
+     */
+    std::vector<HeaterNum> _statesWords;
+    std::vector<HeaterNum> _secondWords;
+    std::vector<unsigned char> _isSecondWord;
+
+    /**
+     * Копия схемы читателей, построенная по версии мощностей _scheduleVersion,
+     * и изменения, которые к ней применяются (память выделена в конструкторе)
+     */
+    std::mutex _scheduleMutex;
+    HeatSchedule _schedule;
+    std::uint32_t _scheduleVersion = 0;
+    HeaterPowers _scheduleChanges;
+};
+
+#endif //HEATERS_CONCURRENT_HEATERS_H
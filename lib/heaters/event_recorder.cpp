@@ -0,0 +1,417 @@
+#include "event_recorder.h"
+
+#include <fstream>
+#include <iterator>
+
+namespace {
+    const std::uint64_t FNV_OFFSET = 14695981039346656037ull;
+    const std::uint64_t FNV_PRIME = 1099511628211ull;
+
+    std::uint64_t fold(std::uint64_t digest, std::uint64_t value) {
+        return (digest ^ value) * FNV_PRIME;
+    }
+
+    std::uint64_t zigzag(std::int64_t value) {
+        return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    }
+
+    std::int64_t unzigzag(std::uint64_t value) {
+        return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+    }
+
+    /**
+     * Последовательное чтение записи; при выходе за границы или переполнении varint
+     * чтение останавливается на смещении ошибки
+     */
+    class RecordingReader {
+    public:
+        RecordingReader(const unsigned char* data, std::size_t size)
+                : _data(data), _size(size) {
+        }
+
+        bool getByte(unsigned char& byte) {
+            if(_failed || _offset >= _size) return _fail();
+
+            byte = _data[_offset++];
+
+            return true;
+        }
+
+        bool getVarint(std::uint64_t& value) {
+            value = 0;
+
+            for(unsigned shift = 0; shift < 64; shift += 7) {
+                unsigned char byte = 0;
+
+                if(!getByte(byte)) return false;
+
+                value |= static_cast<std::uint64_t>(byte & 0x7fu) << shift;
+
+                if(!(byte & 0x80u)) return true;
+            }
+
+            return _fail();
+        }
+
+        bool getFixed(std::uint64_t& value, unsigned bytes = 8) {
+            value = 0;
+
+            for(unsigned shift = 0; shift < bytes * 8; shift += 8) {
+                unsigned char byte = 0;
+
+                if(!getByte(byte)) return false;
+
+                value |= static_cast<std::uint64_t>(byte) << shift;
+            }
+
+            return true;
+        }
+
+        /**
+         * Читает нагреватель, записанный приращением к предыдущему
+         */
+        bool getHeater(HeaterNum heatersNum, HeaterNum& heater) {
+            std::uint64_t delta = 0;
+
+            if(!getVarint(delta)) return false;
+
+            std::int64_t value = static_cast<std::int64_t>(_lastHeater) + unzigzag(delta);
+
+            if(value < 0 || value >= static_cast<std::int64_t>(heatersNum)) return _fail();
+
+            heater = _lastHeater = static_cast<HeaterNum>(value);
+
+            return true;
+        }
+
+        bool getPower(Power& power) {
+            std::uint64_t value = 0;
+
+            if(!getVarint(value)) return false;
+            if(value > Heater::MAXIMUM_POWER) return _fail();
+
+            power = static_cast<Power>(value);
+
+            return true;
+        }
+
+        bool isEnd() const {
+            return _offset >= _size;
+        }
+
+        std::size_t getOffset() const {
+            return _offset;
+        }
+
+    private:
+        bool _fail() {
+            _failed = true;
+
+            return false;
+        }
+
+    private:
+        const unsigned char* _data;
+        std::size_t _size;
+        std::size_t _offset = 0;
+        bool _failed = false;
+        HeaterNum _lastHeater = 0;
+    };
+}
+
+StatesDigest::StatesDigest(IHeatSink* sink) : _sink(sink), _digest(FNV_OFFSET) {
+}
+
+void StatesDigest::setStates(const HeatStateWord* states, const HeatStateWord* changed,
+                             std::size_t wordsCount) {
+    std::uint64_t frame = 0;
+
+    for(std::size_t word = 0; word < wordsCount; ++word) {
+        if(states[word]) frame += _digestWord(word, states[word]);
+    }
+
+    _digest = fold(_digest, frame);
+
+    if(_sink) _sink->setStates(states, changed, wordsCount);
+}
+
+void StatesDigest::setActiveStates(const HeatStateWord* states, const HeatStateWord* changed,
+                                   std::size_t wordsCount, const HeaterNum* activeWords, std::size_t activeCount) {
+    std::uint64_t frame = 0;
+
+    for(std::size_t active = 0; active < activeCount; ++active) {
+        HeaterNum word = activeWords[active];
+
+        if(states[word]) frame += _digestWord(word, states[word]);
+    }
+
+    _digest = fold(_digest, frame);
+
+    if(_sink) _sink->setActiveStates(states, changed, wordsCount, activeWords, activeCount);
+}
+
+std::uint64_t StatesDigest::take() {
+    std::uint64_t digest = _digest;
+
+    _digest = FNV_OFFSET;
+
+    return digest;
+}
+
+std::uint64_t StatesDigest::_digestWord(std::size_t word, HeatStateWord states) {
+    return fold(fold(FNV_OFFSET, word), states);
+}
+
+std::uint64_t StatesDigest::digestPowers(IHeaters& heaters, HeaterNum heatersNum) {
+    std::uint64_t digest = FNV_OFFSET;
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        digest = fold(digest, heaters.getPower(heater));
+    }
+
+    return digest;
+}
+
+EventRecorder::EventRecorder(HeaterNum heatersNum, ScheduleLayout layout, std::size_t capacity)
+        : _data(new unsigned char[capacity]), _capacity(capacity) {
+    if(!_reserve(4 + 2 + VARINT_SIZE)) return;
+
+    _putFixed(MAGIC, 4);
+    _putByte(VERSION);
+    _putByte(static_cast<unsigned char>(layout));
+    _putVarint(heatersNum);
+}
+
+void EventRecorder::recordSetPower(HeaterNum heater, Power power) {
+    flush();
+
+    if(!_reserve(1 + 2 * VARINT_SIZE)) return;
+
+    _putByte(static_cast<unsigned char>(RecordedEvent::SET_POWER));
+    _putHeater(heater);
+    _putVarint(power);
+}
+
+void EventRecorder::recordSetPowers(const HeaterPowers& powers, PowersCommit commit) {
+    flush();
+
+    if(!_reserve(1 + VARINT_SIZE + powers.size() * 2 * VARINT_SIZE)) return;
+
+    _putByte(static_cast<unsigned char>(commit == PowersCommit::NEXT_SECOND
+                                        ? RecordedEvent::SET_POWERS_NEXT_SECOND
+                                        : RecordedEvent::SET_POWERS_NEXT_FRAME));
+    _putVarint(powers.size());
+    _putPowers(powers);
+}
+
+void EventRecorder::recordZeroCrossed() {
+    if(_overflowed) return;
+
+    ++_frameIndex;
+
+    if(++_pendingZeroCrosses == MAX_ZERO_CROSSES) flush();
+}
+
+void EventRecorder::recordCheckpoint(std::uint64_t statesDigest, std::uint64_t powersDigest) {
+    flush();
+
+    if(!_reserve(1 + 2 * 8)) return;
+
+    _putByte(static_cast<unsigned char>(RecordedEvent::CHECKPOINT));
+    _putFixed(statesDigest);
+    _putFixed(powersDigest);
+}
+
+void EventRecorder::flush() {
+    if(!_pendingZeroCrosses || !_reserve(1 + VARINT_SIZE)) return;
+
+    _putByte(static_cast<unsigned char>(RecordedEvent::ZERO_CROSSED));
+    _putVarint(_pendingZeroCrosses);
+    _pendingZeroCrosses = 0;
+}
+
+bool EventRecorder::save(const std::string& path) {
+    flush();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+    file.write(reinterpret_cast<const char*>(_data.get()), static_cast<std::streamsize>(_size));
+
+    return static_cast<bool>(file);
+}
+
+const unsigned char* EventRecorder::getData() const {
+    return _data.get();
+}
+
+std::size_t EventRecorder::getSize() const {
+    return _size;
+}
+
+bool EventRecorder::isOverflowed() const {
+    return _overflowed;
+}
+
+std::uint64_t EventRecorder::getFrameIndex() const {
+    return _frameIndex;
+}
+
+bool EventRecorder::_reserve(std::size_t size) {
+    if(_overflowed) return false;
+
+    if(_capacity - _size < size) {
+        _overflowed = true;
+        _pendingZeroCrosses = 0;
+    }
+
+    return !_overflowed;
+}
+
+void EventRecorder::_putByte(unsigned char byte) {
+    _data[_size++] = byte;
+}
+
+void EventRecorder::_putVarint(std::uint64_t value) {
+    while(value >= 0x80u) {
+        _putByte(static_cast<unsigned char>(value | 0x80u));
+        value >>= 7;
+    }
+
+    _putByte(static_cast<unsigned char>(value));
+}
+
+void EventRecorder::_putFixed(std::uint64_t value, unsigned bytes) {
+    for(unsigned shift = 0; shift < bytes * 8; shift += 8) {
+        _putByte(static_cast<unsigned char>(value >> shift));
+    }
+}
+
+void EventRecorder::_putHeater(HeaterNum heater) {
+    _putVarint(zigzag(static_cast<std::int64_t>(heater) - static_cast<std::int64_t>(_lastHeater)));
+    _lastHeater = heater;
+}
+
+void EventRecorder::_putPowers(const HeaterPowers& powers) {
+    for(const auto& heaterAndPower: powers) {
+        _putHeater(heaterAndPower.first);
+        _putVarint(heaterAndPower.second);
+    }
+}
+
+ReplayReport replayRecording(const unsigned char* data, std::size_t size, IHeatSink* sink) {
+    ReplayReport report;
+    RecordingReader reader(data, size);
+
+    std::uint64_t magic = 0;
+    unsigned char version = 0;
+    unsigned char layout = 0;
+    std::uint64_t heatersNum = 0;
+
+    bool header = reader.getFixed(magic, 4) && reader.getByte(version) && reader.getByte(layout)
+                  && reader.getVarint(heatersNum);
+
+    if(!header || magic != EventRecorder::MAGIC || version != EventRecorder::VERSION
+       || layout > static_cast<unsigned char>(ScheduleLayout::BALANCED)
+       || heatersNum > static_cast<HeaterNum>(-1)) {
+        report.errorOffset = reader.getOffset();
+        return report;
+    }
+
+    StatesDigest digest(sink);
+    Heaters heaters(static_cast<HeaterNum>(heatersNum), digest, static_cast<ScheduleLayout>(layout));
+    HeaterPowers powers;
+
+    while(!reader.isEnd()) {
+        std::size_t eventOffset = reader.getOffset();
+        unsigned char type = 0;
+        bool read = reader.getByte(type);
+
+        switch(static_cast<RecordedEvent>(type)) {
+            case RecordedEvent::ZERO_CROSSED: {
+                std::uint64_t count = 0;
+
+                read = reader.getVarint(count) && count <= EventRecorder::MAX_ZERO_CROSSES;
+
+                for(std::uint64_t i = 0; read && i < count; ++i) {
+                    heaters.zeroCrossed();
+                }
+
+                if(read) report.frames += count;
+                break;
+            }
+            case RecordedEvent::SET_POWER: {
+                HeaterNum heater = 0;
+                Power power = 0;
+
+                read = reader.getHeater(static_cast<HeaterNum>(heatersNum), heater) && reader.getPower(power);
+
+                if(read) heaters.setPower(heater, power);
+                break;
+            }
+            case RecordedEvent::SET_POWERS_NEXT_FRAME:
+            case RecordedEvent::SET_POWERS_NEXT_SECOND: {
+                std::uint64_t count = 0;
+
+                read = reader.getVarint(count) && count <= size;
+                powers.clear();
+
+                for(std::uint64_t i = 0; read && i < count; ++i) {
+                    HeaterNum heater = 0;
+                    Power power = 0;
+
+                    read = reader.getHeater(static_cast<HeaterNum>(heatersNum), heater) && reader.getPower(power);
+                    powers.emplace_back(heater, power);
+                }
+
+                if(read) {
+                    heaters.setPowers(powers, static_cast<RecordedEvent>(type) == RecordedEvent::SET_POWERS_NEXT_SECOND
+                                              ? PowersCommit::NEXT_SECOND : PowersCommit::NEXT_FRAME);
+                }
+                break;
+            }
+            case RecordedEvent::CHECKPOINT: {
+                std::uint64_t statesDigest = 0;
+                std::uint64_t powersDigest = 0;
+
+                read = reader.getFixed(statesDigest) && reader.getFixed(powersDigest);
+
+                if(!read) break;
+
+                ++report.checkpoints;
+
+                bool statesMatch = digest.take() == statesDigest;
+                bool powersMatch = StatesDigest::digestPowers(heaters, static_cast<HeaterNum>(heatersNum))
+                                   == powersDigest;
+
+                if(!statesMatch || !powersMatch) {
+                    if(!report.mismatches) report.firstMismatchFrame = report.frames;
+                    ++report.mismatches;
+                }
+                break;
+            }
+            default:
+                read = false;
+        }
+
+        if(!read) {
+            report.errorOffset = eventOffset;
+            return report;
+        }
+
+        ++report.events;
+    }
+
+    report.valid = true;
+
+    return report;
+}
+
+bool loadRecording(const std::string& path, std::vector<unsigned char>& data) {
+    std::ifstream file(path, std::ios::binary);
+
+    if(!file) return false;
+
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+
+    return !file.bad();
+}
@@ -0,0 +1,214 @@
+#ifndef HEATERS_EVENT_RECORDER_H
+#define HEATERS_EVENT_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "variables_description.h"
+#include "heat_sink.h"
+#include "heaters.h"
+
+/**
+ * Формат записи вызовов модуля Heaters.
+ *
+ * Заголовок: "HREC", версия (байт), раскладка (байт), varint количество нагревателей.
+ * Далее события - байт типа и поля в виде varint (LEB128).
+ * Номер кадра события не хранится: он равен количеству предшествующих переходов через ноль,
+ * а подряд идущие переходы через ноль записываются одним событием с их количеством.
+ * Номер нагревателя хранится приращением (zigzag) к номеру из предыдущего события.
+ */
+enum class RecordedEvent : unsigned char {
+    /**
+     * varint количество переходов через ноль (не больше EventRecorder::MAX_ZERO_CROSSES)
+     */
+    ZERO_CROSSED = 1,
+    /**
+     * нагреватель, varint мощность
+     */
+    SET_POWER = 2,
+    /**
+     * varint количество пар, пары (нагреватель, varint мощность)
+     */
+    SET_POWERS_NEXT_FRAME = 3,
+    SET_POWERS_NEXT_SECOND = 4,
+    /**
+     * 8 байт свёртки состояний за прошедшую секунду, 8 байт свёртки мощностей getPower
+     */
+    CHECKPOINT = 5
+};
+
+/**
+ * Приёмник, сворачивающий упакованные состояния в 64-битную свёртку (FNV-1a)
+ * и передающий их дальше.
+ *
+ * Полупериод сворачивается суммой свёрток ненулевых слов с их номерами, поэтому
+ * свёртка не зависит от порядка активных слов и совпадает для setStates и setActiveStates
+ */
+class StatesDigest : public IHeatSink {
+public:
+    /**
+     * @param sink - приёмник, которому передаются состояния (может отсутствовать)
+     */
+    explicit StatesDigest(IHeatSink* sink = nullptr);
+
+    void setStates(const HeatStateWord* states, const HeatStateWord* changed,
+                   std::size_t wordsCount) override;
+
+    /**
+     * Сворачивает только активные слова (в неактивных словах состояния нулевые)
+     * и передаёт их приёмнику вместе со списком активных слов
+     */
+    void setActiveStates(const HeatStateWord* states, const HeatStateWord* changed, std::size_t wordsCount,
+                         const HeaterNum* activeWords, std::size_t activeCount) override;
+
+    /**
+     * Возвращает свёртку состояний с прошлого вызова и начинает новую
+     */
+    std::uint64_t take();
+
+    /**
+     * Свёртка последних мощностей (getPower без смещения) всех нагревателей
+     */
+    static std::uint64_t digestPowers(IHeaters& heaters, HeaterNum heatersNum);
+
+private:
+    static std::uint64_t _digestWord(std::size_t word, HeatStateWord states);
+
+private:
+    IHeatSink* _sink;
+    std::uint64_t _digest;
+};
+
+/**
+ * Запись вызовов модуля в заранее выделенный буфер.
+ *
+ * Запись события - несколько байт без выделения памяти, переход через ноль
+ * только увеличивает счётчик. Если событие не помещается в буфер,
+ * запись прекращается (isOverflowed), чтобы в ней не было пропусков.
+ */
+class EventRecorder {
+public:
+    static const std::uint32_t MAGIC = 0x43455248;
+    static const unsigned char VERSION = 2;
+    /**
+     * Наибольшее количество переходов через ноль в одном событии: длинный простой
+     * записывается несколькими событиями, а запись с большим количеством некорректна
+     */
+    static const std::uint64_t MAX_ZERO_CROSSES = 1u << 20;
+
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param layout - способ раскладки нагревателей по полупериодам
+     *
+     * @param capacity - размер буфера записи в байтах
+     */
+    EventRecorder(HeaterNum heatersNum, ScheduleLayout layout, std::size_t capacity);
+
+    void recordSetPower(HeaterNum heater, Power power);
+
+    void recordSetPowers(const HeaterPowers& powers, PowersCommit commit);
+
+    void recordZeroCrossed();
+
+    void recordCheckpoint(std::uint64_t statesDigest, std::uint64_t powersDigest);
+
+    /**
+     * Дописывает накопленные переходы через ноль
+     */
+    void flush();
+
+    /**
+     * Сохраняет запись (вместе с накопленными переходами через ноль) в файл
+     *
+     * @return false, если файл не удалось записать
+     */
+    bool save(const std::string& path);
+
+    const unsigned char* getData() const;
+
+    std::size_t getSize() const;
+
+    bool isOverflowed() const;
+
+    /**
+     * Номер текущего кадра записи (количество записанных переходов через ноль)
+     */
+    std::uint64_t getFrameIndex() const;
+
+private:
+    /**
+     * Наибольший размер varint
+     */
+    static const std::size_t VARINT_SIZE = 10;
+
+private:
+    /**
+     * Проверяет, что в буфере есть size байт, иначе прекращает запись
+     */
+    bool _reserve(std::size_t size);
+
+    void _putByte(unsigned char byte);
+
+    void _putVarint(std::uint64_t value);
+
+    void _putFixed(std::uint64_t value, unsigned bytes = 8);
+
+    void _putHeater(HeaterNum heater);
+
+    void _putPowers(const HeaterPowers& powers);
+
+private:
+    std::unique_ptr<unsigned char[]> _data;
+    std::size_t _capacity;
+    std::size_t _size = 0;
+    bool _overflowed = false;
+    std::uint64_t _frameIndex = 0;
+    std::uint64_t _pendingZeroCrosses = 0;
+    HeaterNum _lastHeater = 0;
+};
+
+/**
+ * Результат воспроизведения записи
+ */
+struct ReplayReport {
+    /**
+     * Запись прочитана полностью
+     */
+    bool valid = false;
+    /**
+     * Смещение первого некорректного байта (для некорректной записи)
+     */
+    std::size_t errorOffset = 0;
+    std::uint64_t events = 0;
+    std::uint64_t frames = 0;
+    std::uint64_t checkpoints = 0;
+    /**
+     * Контрольные точки, свёртки которых не совпали с записанными
+     */
+    std::uint64_t mismatches = 0;
+    /**
+     * Кадр первого несовпадения
+     */
+    std::uint64_t firstMismatchFrame = 0;
+};
+
+/**
+ * Воспроизводит запись на новом модуле Heaters с максимальной скоростью
+ * и сверяет состояния и историю мощностей с контрольными точками записи
+ *
+ * @param sink - приёмник, которому передаются состояния (может отсутствовать)
+ */
+ReplayReport replayRecording(const unsigned char* data, std::size_t size, IHeatSink* sink = nullptr);
+
+/**
+ * Читает запись из файла
+ *
+ * @return false, если файл не удалось прочитать
+ */
+bool loadRecording(const std::string& path, std::vector<unsigned char>& data);
+
+#endif //HEATERS_EVENT_RECORDER_H
@@ -0,0 +1,246 @@
+#ifndef HEATERS_HEAT_CHAINS_H
+#define HEATERS_HEAT_CHAINS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+#include "variables_description.h"
+#include "heater_frame.h"
+
+/**
+ * Способ раскладки нагревателей по кадрам
+ */
+enum class ScheduleLayout {
+    /**
+     * Все нагреватели раскладываются по кругу одной цепочкой в порядке номеров
+     */
+    SEQUENTIAL,
+    /**
+     * Верхние (чётные) и нижние (нечётные) нагреватели раскладываются
+     * по кругу двумя независимыми цепочками, каждая с нулевого кадра.
+     *
+     * Отрезки одной группы не перекрываются, пока не заполнят все кадры,
+     * поэтому максимальное количество одновременно включённых нагревателей группы
+     * равно ceil(суммарная мощность группы / количество кадров) - это наименьший
+     * возможный пик при заданных мощностях.
+     */
+    BALANCED
+};
+
+/**
+ * Раскладка нагревателей по цепочкам кадров - алгоритм, общий для HeatSchedule и StaticHeatSchedule
+ * (см. описание HeatSchedule).
+ *
+ * Хранит только размеры схемы, а мощности, начальные кадры и битовые наборы кадров
+ * получает указателями при каждом вызове: хранилище может быть и в куче, и внутри объекта.
+ * Счётчики кадров ведёт владелец схемы - изменения передаются ему функцией обратного вызова.
+ */
+class HeatChains {
+public:
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param frameCount - количество кадров в 1 секунде
+     *
+     * @param chainStep - шаг между соседними нагревателями цепочки (1 - SEQUENTIAL, 2 - BALANCED)
+     *
+     * @param wordsPerFrame - количество слов битового набора одного кадра
+     */
+    HeatChains(HeaterNum heatersNum, Frame frameCount, HeaterNum chainStep, HeaterNum wordsPerFrame)
+            : _heatersNum(heatersNum), _frameCount(frameCount), _chainStep(chainStep),
+              _wordsPerFrame(wordsPerFrame) {
+    }
+
+    /**
+     * Перечисляет изменения кадров, к которым приведёт установка мощности нагревателю,
+     * не изменяя схему.
+     *
+     * @note Обходит все последующие нагреватели цепочки (их отрезки сдвигаются): O(N * |разница|)
+     *
+     * @param change - вызывается для каждого изменения как
+     *        change(heater, from, count, add): нагреватель heater добавляется (add == true)
+     *        или удаляется из count кадров подряд, начиная с кадра from
+     */
+    template<typename Change>
+    void forEachChange(const Power* powers, const Frame* starts,
+                       HeaterNum heater, Power power, Change&& change) const;
+
+    /**
+     * Устанавливает мощность нагревателя: изменяет биты кадров и сдвигает
+     * начальные кадры последующих нагревателей цепочки
+     *
+     * @param count - вызывается для каждого изменения, как change в forEachChange(),
+     *        после изменения бит (для обновления счётчиков кадров)
+     */
+    template<typename Count>
+    void setPower(Power* powers, Frame* starts, HeatFrameWord* frameWords,
+                  HeaterNum heater, Power power, Count&& count) const;
+
+    /**
+     * Раскладывает все нагреватели заново по их мощностям: заполняет начальные кадры
+     * и биты кадров (счётчики кадров пересчитывает владелец)
+     */
+    void layout(const Power* powers, Frame* starts, HeatFrameWord* frameWords) const;
+
+    /**
+     * Вычисляет пики чётных и нечётных нагревателей после установки мощности нагревателю
+     * по текущим счётчикам кадров, не изменяя схему
+     *
+     * @param counts - counts(frame) возвращает пару (чётные, нечётные) включённых нагревателей кадра
+     *
+     * @return first - чётные, second - нечётные
+     */
+    template<typename Counts>
+    std::pair<HeaterNum, HeaterNum> getPeaksAfterChange(const Power* powers, const Frame* starts,
+                                                        HeaterNum heater, Power power, Counts&& counts) const;
+
+    /**
+     * Максимально допустимое количество кадров в 1 секунде (сеть 60Гц)
+     */
+    static const Frame MAX_FRAME_COUNT = 120;
+
+private:
+    /**
+     * Изменяет бит нагревателя в count кадрах подряд, начиная с кадра from
+     */
+    void _changeBits(HeatFrameWord* frameWords, HeaterNum heater, Frame from, Power count, bool add) const;
+
+private:
+    HeaterNum _heatersNum;
+    Frame _frameCount;
+    HeaterNum _chainStep;
+    HeaterNum _wordsPerFrame;
+};
+
+template<typename Change>
+void HeatChains::forEachChange(const Power* powers, const Frame* starts,
+                               HeaterNum heater, Power power, Change&& change) const {
+    Power oldPower = powers[heater];
+
+    if(power == oldPower) return;
+
+    int delta = static_cast<int>(power) - static_cast<int>(oldPower);
+
+    // Изменяем хвост отрезка самого нагревателя
+    if(delta > 0) {
+        change(heater, (starts[heater] + oldPower) % _frameCount, delta, true);
+    } else {
+        change(heater, (starts[heater] + power) % _frameCount, -delta, false);
+    }
+
+    // Из отрезка последующего нагревателя цепочки уходит и в него приходит не больше |delta| кадров
+    Power distance = static_cast<Power>(delta > 0 ? delta : -delta);
+
+    for(HeaterNum next = heater + _chainStep; next < _heatersNum; next += _chainStep) {
+        Frame start = starts[next];
+        Power nextPower = powers[next];
+
+        // Пустой отрезок и отрезок на всю секунду от сдвига не меняются
+        if(nextPower == 0 || nextPower >= _frameCount) continue;
+
+        Frame newStart = (start + _frameCount + delta % _frameCount) % _frameCount;
+        Power moved = std::min(distance, nextPower);
+
+        if(delta > 0) {
+            change(next, start, moved, false);
+            change(next, (newStart + nextPower - moved) % _frameCount, moved, true);
+        } else {
+            change(next, (start + nextPower - moved) % _frameCount, moved, false);
+            change(next, newStart, moved, true);
+        }
+    }
+}
+
+template<typename Count>
+void HeatChains::setPower(Power* powers, Frame* starts, HeatFrameWord* frameWords,
+                          HeaterNum heater, Power power, Count&& count) const {
+    Power oldPower = powers[heater];
+
+    if(power == oldPower) return;
+
+    forEachChange(powers, starts, heater, power,
+                  [this, frameWords, &count](HeaterNum changed, Frame from, Power frames, bool add) {
+        _changeBits(frameWords, changed, from, frames, add);
+        count(changed, from, frames, add);
+    });
+
+    int delta = static_cast<int>(power) - static_cast<int>(oldPower);
+
+    powers[heater] = power;
+
+    // Последующие нагреватели цепочки начинаются на delta кадров позже (раньше)
+    for(HeaterNum next = heater + _chainStep; next < _heatersNum; next += _chainStep) {
+        starts[next] = (starts[next] + _frameCount + delta % _frameCount) % _frameCount;
+    }
+}
+
+inline void HeatChains::layout(const Power* powers, Frame* starts, HeatFrameWord* frameWords) const {
+    std::fill(frameWords, frameWords + static_cast<std::size_t>(_frameCount) * _wordsPerFrame, 0);
+
+    // Кадр, на котором закончился последний нагреватель каждой цепочки
+    Frame chainEnds[2] = {0, 0};
+
+    for(HeaterNum heater = 0; heater < _heatersNum; ++heater) {
+        Frame& start = chainEnds[heater % _chainStep];
+
+        starts[heater] = start;
+        _changeBits(frameWords, heater, start, powers[heater], true);
+
+        start = static_cast<Frame>((start + powers[heater]) % _frameCount);
+    }
+}
+
+template<typename Counts>
+std::pair<HeaterNum, HeaterNum> HeatChains::getPeaksAfterChange(const Power* powers, const Frame* starts,
+                                                                HeaterNum heater, Power power,
+                                                                Counts&& counts) const {
+    // Изменения счётчиков чётных [0] и нечётных [1] нагревателей по кадрам
+    int diff[2][MAX_FRAME_COUNT] = {};
+
+    forEachChange(powers, starts, heater, power, [this, &diff](HeaterNum changed, Frame from, Power count, bool add) {
+        int* parityDiff = diff[changed % 2];
+        Frame frame = from;
+
+        for(Power i = 0; i < count; ++i) {
+            parityDiff[frame] += add ? 1 : -1;
+
+            ++frame;
+
+            if(frame >= _frameCount) frame = 0;
+        }
+    });
+
+    HeaterNum maxEvenHeaters = 0;
+    HeaterNum maxOddHeaters = 0;
+
+    for(Frame frame = 0; frame < _frameCount; ++frame) {
+        std::pair<HeaterNum, HeaterNum> evenOdd = counts(frame);
+
+        maxEvenHeaters = std::max<HeaterNum>(maxEvenHeaters, evenOdd.first + diff[0][frame]);
+        maxOddHeaters = std::max<HeaterNum>(maxOddHeaters, evenOdd.second + diff[1][frame]);
+    }
+
+    return {maxEvenHeaters, maxOddHeaters};
+}
+
+inline void HeatChains::_changeBits(HeatFrameWord* frameWords, HeaterNum heater, Frame from,
+                                    Power count, bool add) const {
+    HeatFrameWord bit = HeatFrameWord(1) << (heater % HEAT_FRAME_WORD_BITS);
+    HeatFrameWord* word = frameWords + heater / HEAT_FRAME_WORD_BITS;
+    Frame frame = from;
+
+    for(Power i = 0; i < count; ++i) {
+        if(add) {
+            word[static_cast<std::size_t>(frame) * _wordsPerFrame] |= bit;
+        } else {
+            word[static_cast<std::size_t>(frame) * _wordsPerFrame] &= ~bit;
+        }
+
+        ++frame;
+
+        if(frame >= _frameCount) frame = 0;
+    }
+}
+
+#endif //HEATERS_HEAT_CHAINS_H
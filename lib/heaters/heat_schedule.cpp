@@ -0,0 +1,469 @@
+#include "heat_schedule.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+HeatSchedule::HeatSchedule(HeaterNum heatersNum, Frame frameCount, ScheduleLayout layout)
+        : _frameCount(frameCount), _chainStep(layout == ScheduleLayout::BALANCED ? 2 : 1), _powers(heatersNum, 0), _starts(heatersNum, 0), _frames(frameCount),
+          _wordsPerFrame((heatersNum + HEAT_FRAME_WORD_BITS - 1) / HEAT_FRAME_WORD_BITS),
+          _frameWords(static_cast<std::size_t>(frameCount) * _wordsPerFrame, 0),
+          _groupOffsets(heatersNum + 1, 0), _budgetSlots(heatersNum, 0) {
+}
+
+void HeatSchedule::setPower(HeaterNum heater, Power power) {
+    _chains().setPower(_powers.data(), _starts.data(), _frameWords.data(), heater, power,
+                       [this](HeaterNum changed, Frame from, Power count, bool add) {
+        _countFrames(changed, from, count, add);
+    });
+}
+
+void HeatSchedule::setPowers(const HeaterPowers& powers) {
+    // Сдвиг хвоста цепочки на delta кадров меняет до 2 * |delta| кадров каждого его нагревателя,
+    // перестроение - все кадры всех нагревателей
+    std::size_t rebuildCost = _powers.size() * _frameCount;
+    std::size_t shiftCost = 0;
+
+    for(const auto& heaterAndPower: powers) {
+        std::size_t delta = static_cast<std::size_t>(std::abs(static_cast<int>(heaterAndPower.second) -
+                                                              static_cast<int>(_powers[heaterAndPower.first])));
+        std::size_t tail = (_powers.size() - heaterAndPower.first + _chainStep - 1) / _chainStep;
+
+        shiftCost += 2 * delta * tail;
+
+        if(shiftCost > rebuildCost) break;
+    }
+
+    if(shiftCost <= rebuildCost) {
+        for(const auto& heaterAndPower: powers) {
+            setPower(heaterAndPower.first, heaterAndPower.second);
+        }
+
+        return;
+    }
+
+    for(const auto& heaterAndPower: powers) {
+        _powers[heaterAndPower.first] = heaterAndPower.second;
+    }
+
+    _rebuild();
+}
+
+Power HeatSchedule::getPower(HeaterNum heater) const {
+    return _powers[heater];
+}
+
+bool HeatSchedule::isHeating(HeaterNum heater, Frame frame) const {
+    HeatFrameWord word = getFrameWords(frame)[heater / HEAT_FRAME_WORD_BITS];
+
+    return (word >> (heater % HEAT_FRAME_WORD_BITS)) & 1u;
+}
+
+Power HeatSchedule::getHeatingFrames(HeaterNum heater, Frame from, Frame to) const {
+    auto overlap = [from, to](int begin, int end) {
+        return std::max(0, std::min<int>(to, end) - std::max<int>(from, begin));
+    };
+
+    int start = _starts[heater];
+    int end = start + static_cast<int>(_powers[heater]);
+
+    // Отрезок нагревателя может переходить через конец секунды
+    return static_cast<Power>(overlap(start, end) + overlap(start - _frameCount, end - _frameCount));
+}
+
+const HeatFrame& HeatSchedule::getFrame(Frame frame) const {
+    return _frames[frame];
+}
+
+const HeatFrameWord* HeatSchedule::getFrameWords(Frame frame) const {
+    return _frameWords.data() + static_cast<std::size_t>(frame) * _wordsPerFrame;
+}
+
+HeaterNum HeatSchedule::getWordsPerFrame() const {
+    return _wordsPerFrame;
+}
+
+std::pair<HeaterNum, HeaterNum> HeatSchedule::getMaximumEvenOddHeaters() const {
+    HeaterNum maxEvenHeaters = 0;
+    HeaterNum maxOddHeaters = 0;
+
+    for(const HeatFrame& frame: _frames) {
+        if (frame.getOddHeatersCount() > maxOddHeaters) {
+            maxOddHeaters = frame.getOddHeatersCount();
+        }
+
+        if (frame.getEvenHeatersCount() > maxEvenHeaters) {
+            maxEvenHeaters = frame.getEvenHeatersCount();
+        }
+    }
+
+    return {maxEvenHeaters, maxOddHeaters};
+}
+
+std::pair<HeaterNum, HeaterNum> HeatSchedule::getMaximumEvenOddHeatersAfterPowerChange(HeaterNum heater,
+                                                                                    Power power) const {
+    return _chains().getPeaksAfterChange(_powers.data(), _starts.data(), heater, power, [this](Frame frame) {
+        return std::make_pair(_frames[frame].getEvenHeatersCount(), _frames[frame].getOddHeatersCount());
+    });
+}
+
+void HeatSchedule::getMaximumEvenOddHeatersAfterPowerChanges(
+        const HeaterPowers& candidates, std::vector<std::pair<HeaterNum, HeaterNum>>& peaks,
+        std::vector<std::size_t>& order) const {
+    peaks.assign(candidates.size(), getMaximumEvenOddHeaters());
+    order.clear();
+
+    for(std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+        if(candidates[candidate].first < _powers.size() && candidates[candidate].second <= _frameCount) {
+            order.push_back(candidate);
+        }
+    }
+
+    std::sort(order.begin(), order.end(), [&candidates](std::size_t left, std::size_t right) {
+        return candidates[left].first < candidates[right].first;
+    });
+
+    FrameCounters total[2];
+    FrameCounters prefix[2][2] = {};
+    HeaterNum swept = 0;
+
+    _countTotals(total);
+
+    for(std::size_t candidate: order) {
+        HeaterNum heater = candidates[candidate].first;
+
+        _sweepChains(heater, prefix, swept);
+        peaks[candidate] = _peaksAfterChange(total, prefix, heater, candidates[candidate].second);
+    }
+}
+
+bool HeatSchedule::getMaximumAdmissiblePower(HeaterNum heater, HeaterNum maxEven, HeaterNum maxOdd,
+                                             Power& power, Power limit) const {
+    if(heater >= _powers.size()) return false;
+
+    FrameCounters total[2];
+    FrameCounters prefix[2][2] = {};
+    HeaterNum swept = 0;
+
+    _countTotals(total);
+    _sweepChains(heater, prefix, swept);
+
+    // Пики не обязаны расти с мощностью (сдвиг последующих нагревателей может их уменьшить),
+    // поэтому проверяются все мощности сверху вниз
+    for(int candidate = std::min<Power>(limit, _frameCount); candidate >= 0; --candidate) {
+        auto peaks = _peaksAfterChange(total, prefix, heater, static_cast<Power>(candidate));
+
+        if(peaks.first <= maxEven && peaks.second <= maxOdd) {
+            power = static_cast<Power>(candidate);
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+std::uint32_t HeatSchedule::distributePowerBudget(const std::vector<HeaterNum>& heaters, std::uint32_t budget,
+                                                  HeaterNum maxEven, HeaterNum maxOdd, HeaterPowers& powers) {
+    powers.clear();
+
+    HeaterNum last = 0;
+
+    for(HeaterNum heater: heaters) {
+        // Повтор нагревателя получил бы долю бюджета второй раз поверх уже установленной мощности
+        if(heater >= _powers.size() || _budgetSlots[heater] != 0) continue;
+
+        setPower(heater, 0);
+        powers.emplace_back(heater, 0);
+        _budgetSlots[heater] = static_cast<std::uint32_t>(powers.size());
+        last = std::max(last, heater);
+    }
+
+    FrameCounters total[2];
+    std::uint32_t remaining = budget;
+    std::size_t growing = powers.size();
+
+    _countTotals(total);
+
+    while(remaining > 0 && growing > 0) {
+        std::uint32_t share = std::max<std::uint32_t>(remaining / growing, 1);
+        // Установка мощности не сдвигает предшествующие нагреватели,
+        // поэтому при обходе по возрастанию номеров начала цепочек накапливаются за один проход
+        FrameCounters prefix[2][2] = {};
+        HeaterNum swept = 0;
+
+        growing = 0;
+
+        for(HeaterNum heater = 0; heater <= last && remaining > 0; ++heater) {
+            if(_budgetSlots[heater] == 0) continue;
+
+            auto& heaterAndPower = powers[_budgetSlots[heater] - 1];
+            Power current = heaterAndPower.second;
+            Power target = static_cast<Power>(std::min<std::uint32_t>({current + share, current + remaining,
+                                                                       _frameCount}));
+
+            _sweepChains(heater, prefix, swept);
+
+            if(target == current) continue;
+
+            Power admissible = _searchAdmissiblePower(total, prefix, heater, current, target, maxEven, maxOdd);
+
+            if(admissible == current) continue;
+
+            setPower(heater, admissible);
+            _countTotals(total);
+
+            // Начало цепочки уже включает нагреватель с прежней мощностью: добавляем хвост его отрезка
+            int* counters = prefix[heater % _chainStep][heater % 2];
+
+            for(Power i = current; i < admissible; ++i) {
+                ++counters[(_starts[heater] + i) % _frameCount];
+            }
+
+            remaining -= admissible - current;
+            heaterAndPower.second = admissible;
+
+            // Нагреватель получил всю долю - возможно, он может расти и дальше
+            if(admissible == target && admissible < _frameCount) ++growing;
+        }
+    }
+
+    for(const auto& heaterAndPower: powers) {
+        _budgetSlots[heaterAndPower.first] = 0;
+    }
+
+    return budget - remaining;
+}
+
+void HeatSchedule::_countTotals(FrameCounters total[2]) const {
+    for(Frame frame = 0; frame < _frameCount; ++frame) {
+        total[0][frame] = static_cast<int>(_frames[frame].getEvenHeatersCount());
+        total[1][frame] = static_cast<int>(_frames[frame].getOddHeatersCount());
+    }
+}
+
+void HeatSchedule::_sweepChains(HeaterNum heater, FrameCounters prefix[2][2], HeaterNum& swept) const {
+    for(; swept <= heater; ++swept) {
+        int* counters = prefix[swept % _chainStep][swept % 2];
+
+        for(Power i = 0; i < _powers[swept]; ++i) {
+            ++counters[(_starts[swept] + i) % _frameCount];
+        }
+    }
+}
+
+Power HeatSchedule::_searchAdmissiblePower(const FrameCounters total[2], const FrameCounters prefix[2][2],
+                                          HeaterNum heater, Power from, Power to,
+                                          HeaterNum maxEven, HeaterNum maxOdd) const {
+    while(from < to) {
+        Power middle = static_cast<Power>(from + (to - from + 1) / 2);
+        auto peaks = _peaksAfterChange(total, prefix, heater, middle);
+
+        if(peaks.first <= maxEven && peaks.second <= maxOdd) {
+            from = middle;
+        } else {
+            to = static_cast<Power>(middle - 1);
+        }
+    }
+
+    return from;
+}
+
+std::pair<HeaterNum, HeaterNum> HeatSchedule::_peaksAfterChange(const FrameCounters total[2],
+                                                                const FrameCounters prefix[2][2],
+                                                                HeaterNum heater, Power power) const {
+    HeaterNum chain = heater % _chainStep;
+    Power oldPower = _powers[heater];
+    // Сдвиг последующих нагревателей цепочки по кольцу кадров
+    int shift = (static_cast<int>(power) - static_cast<int>(oldPower) + _frameCount) % _frameCount;
+    HeaterNum peaks[2] = {0, 0};
+    int changed[MAX_FRAME_COUNT];
+
+    for(HeaterNum parity = 0; parity < 2; ++parity) {
+        // В цепочке BALANCED нагреватели только одной чётности
+        bool inChain = _chainStep == 1 || chain == parity;
+
+        for(Frame frame = 0; frame < _frameCount; ++frame) {
+            changed[frame] = total[parity][frame];
+
+            if(!inChain) continue;
+
+            Frame shifted = static_cast<Frame>((frame + _frameCount - shift) % _frameCount);
+
+            // Последующие нагреватели цепочки: уходят из кадра и приходят из сдвинутого
+            changed[frame] -= total[parity][frame] - prefix[chain][parity][frame];
+            changed[frame] += total[parity][shifted] - prefix[chain][parity][shifted];
+        }
+
+        // Хвост отрезка самого нагревателя
+        if(heater % 2 == parity) {
+            Power from = std::min(oldPower, power);
+            Power to = std::max(oldPower, power);
+
+            for(Power i = from; i < to; ++i) {
+                changed[(_starts[heater] + i) % _frameCount] += power > oldPower ? 1 : -1;
+            }
+        }
+
+        for(Frame frame = 0; frame < _frameCount; ++frame) {
+            peaks[parity] = std::max(peaks[parity], static_cast<HeaterNum>(changed[frame]));
+        }
+    }
+
+    return {peaks[0], peaks[1]};
+}
+
+void HeatSchedule::_rebuild() {
+    _chains().layout(_powers.data(), _starts.data(), _frameWords.data());
+
+    // Счётчики кадров пересчитываются по битовым наборам
+    for(Frame frame = 0; frame < _frameCount; ++frame) {
+        _frames[frame].countHeaters(getFrameWords(frame), _wordsPerFrame);
+    }
+
+    _countGroups();
+}
+
+bool HeatSchedule::setGroups(GroupNum groupsCount, const GroupMemberships& memberships) {
+    if(memberships.size() > _powers.size()) return false;
+
+    for(const auto& groups: memberships) {
+        for(GroupNum group: groups) {
+            if(group >= groupsCount) return false;
+        }
+    }
+
+    _groupsCount = groupsCount;
+    _groupMembers.clear();
+
+    for(HeaterNum heater = 0; heater < _powers.size(); ++heater) {
+        _groupOffsets[heater] = _groupMembers.size();
+
+        if(heater < memberships.size()) {
+            _groupMembers.insert(_groupMembers.end(), memberships[heater].begin(), memberships[heater].end());
+        }
+    }
+
+    _groupOffsets[_powers.size()] = _groupMembers.size();
+    _groupCounts.assign(static_cast<std::size_t>(_frameCount) * _groupsCount, 0);
+
+    _countGroups();
+
+    return true;
+}
+
+GroupNum HeatSchedule::getGroupsCount() const {
+    return _groupsCount;
+}
+
+const HeaterNum* HeatSchedule::getGroupCounts(Frame frame) const {
+    return _groupCounts.data() + static_cast<std::size_t>(frame) * _groupsCount;
+}
+
+void HeatSchedule::getMaximumGroupHeaters(std::vector<HeaterNum>& peaks) const {
+    peaks.assign(_groupsCount, 0);
+
+    for(Frame frame = 0; frame < _frameCount; ++frame) {
+        const HeaterNum* counts = getGroupCounts(frame);
+
+        // Плотный ряд групп кадра - цикл векторизуется компилятором
+        for(GroupNum group = 0; group < _groupsCount; ++group) {
+            peaks[group] = std::max(peaks[group], counts[group]);
+        }
+    }
+}
+
+void HeatSchedule::getMaximumGroupHeatersAfterPowerChange(HeaterNum heater, Power power,
+                                                          std::vector<HeaterNum>& peaks,
+                                                          std::vector<int>& diff) const {
+    if(heater >= _powers.size() || power > _frameCount) {
+        getMaximumGroupHeaters(peaks);
+
+        return;
+    }
+
+    diff.assign(_groupCounts.size(), 0);
+
+    _chains().forEachChange(_powers.data(), _starts.data(), heater, power,
+                            [this, &diff](HeaterNum changed, Frame from, Power count, bool add) {
+        const GroupNum* first = _groupMembers.data() + _groupOffsets[changed];
+        const GroupNum* last = _groupMembers.data() + _groupOffsets[changed + 1];
+        Frame frame = from;
+
+        for(Power i = 0; i < count; ++i) {
+            int* frameDiff = diff.data() + static_cast<std::size_t>(frame) * _groupsCount;
+
+            for(const GroupNum* group = first; group != last; ++group) {
+                frameDiff[*group] += add ? 1 : -1;
+            }
+
+            ++frame;
+
+            if(frame >= _frameCount) frame = 0;
+        }
+    });
+
+    peaks.assign(_groupsCount, 0);
+
+    for(Frame frame = 0; frame < _frameCount; ++frame) {
+        const HeaterNum* counts = getGroupCounts(frame);
+        const int* frameDiff = diff.data() + static_cast<std::size_t>(frame) * _groupsCount;
+
+        for(GroupNum group = 0; group < _groupsCount; ++group) {
+            peaks[group] = std::max(peaks[group], static_cast<HeaterNum>(static_cast<int>(counts[group]) +
+                                                                         frameDiff[group]));
+        }
+    }
+}
+
+void HeatSchedule::_countGroups() {
+    if(_groupsCount == 0) return;
+
+    std::fill(_groupCounts.begin(), _groupCounts.end(), 0);
+
+    for(HeaterNum heater = 0; heater < _powers.size(); ++heater) {
+        _changeGroupCounts(heater, _starts[heater], _powers[heater], 1);
+    }
+}
+
+void HeatSchedule::_changeGroupCounts(HeaterNum heater, Frame from, Power count, int change) {
+    const GroupNum* first = _groupMembers.data() + _groupOffsets[heater];
+    const GroupNum* last = _groupMembers.data() + _groupOffsets[heater + 1];
+
+    if(first == last) return;
+
+    Frame frame = from;
+
+    for(Power i = 0; i < count; ++i) {
+        HeaterNum* counts = _groupCounts.data() + static_cast<std::size_t>(frame) * _groupsCount;
+
+        for(const GroupNum* group = first; group != last; ++group) {
+            counts[*group] += change;
+        }
+
+        ++frame;
+
+        if(frame >= _frameCount) frame = 0;
+    }
+}
+
+HeatChains HeatSchedule::_chains() const {
+    return HeatChains(static_cast<HeaterNum>(_powers.size()), _frameCount, _chainStep, _wordsPerFrame);
+}
+
+void HeatSchedule::_countFrames(HeaterNum heater, Frame from, Power count, bool add) {
+    Frame frame = from;
+
+    for(Power i = 0; i < count; ++i) {
+        if(add) {
+            _frames[frame].addHeater(heater);
+        } else {
+            _frames[frame].removeHeater(heater);
+        }
+
+        ++frame;
+
+        if(frame >= _frameCount) frame = 0;
+    }
+
+    _changeGroupCounts(heater, from, count, add ? 1 : -1);
+}
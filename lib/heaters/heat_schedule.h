@@ -0,0 +1,327 @@
+#ifndef HEATERS_HEAT_SCHEDULE_H
+#define HEATERS_HEAT_SCHEDULE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "variables_description.h"
+#include "heat_chains.h"
+#include "heater_frame.h"
+
+/**
+ * Группы нагрузки каждого нагревателя: memberships[heater] - номера групп нагревателя
+ */
+typedef std::vector<std::vector<GroupNum>> GroupMemberships;
+
+/**
+ * Схема нагревания на 1 секунду.
+ *
+ * Нагреватели раскладываются по кадрам "по кругу" в порядке номеров:
+ * нагреватель занимает power подряд идущих кадров, начиная с кадра,
+ * на котором закончился предыдущий нагреватель цепочки (по модулю количества кадров).
+ * В раскладке SEQUENTIAL цепочка одна, в BALANCED - отдельная для чётных и нечётных нагревателей.
+ * Поэтому каждый нагреватель полностью описывается начальным кадром и мощностью.
+ *
+ * Включённые в кадре нагреватели хранятся плотным битовым набором
+ * (по слову HeatFrameWord на 64 нагревателя), все кадры лежат в одном непрерывном буфере.
+ * Счётчики верхних/нижних нагревателей кадра поддерживаются при изменении отдельных бит
+ * и пересчитываются через popcount по маскам чётных/нечётных бит при перестроении схемы.
+ *
+ * При изменении мощности одного нагревателя схема не перестраивается целиком:
+ *    - у изменённого нагревателя добавляются/удаляются кадры в конце его отрезка;
+ *    - отрезки последующих нагревателей цепочки сдвигаются на разницу мощностей,
+ *      при этом счётчики кадров обновляются только на концах сдвигаемых отрезков
+ *      (не более |разница| кадров на нагреватель).
+ *
+ * Итоговая раскладка в точности совпадает с полным перестроением схемы.
+ * Цена этого - сдвиг всех последующих нагревателей цепочки: установка мощности
+ * стоит O(N * |разница|), а не только кадры самого нагревателя. Затронуть только его кадры
+ * можно лишь с другой раскладкой (без сдвига цепочки), что изменило бы порядок включений.
+ * Алгоритм раскладки общий с StaticHeatSchedule - см. HeatChains.
+ *
+ * Кроме верхних/нижних нагревателей можно задать произвольные группы нагрузки
+ * (например, фаза сети и фидер), нагреватель может входить в несколько групп.
+ * Счётчики групп хранятся плотным массивом [кадр][группа] и обновляются
+ * вместе с битами кадров.
+ */
+class HeatSchedule {
+public:
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param frameCount - количество кадров (полупериодов) в 1 секунде
+     *
+     * @param layout - способ раскладки нагревателей по кадрам
+     */
+    HeatSchedule(HeaterNum heatersNum, Frame frameCount,
+                 ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    /**
+     * Максимально допустимое количество кадров в 1 секунде (сеть 60Гц)
+     */
+    static const Frame MAX_FRAME_COUNT = HeatChains::MAX_FRAME_COUNT;
+
+    /**
+     * Устанавливает мощность нагревателя и обновляет схему
+     *
+     * @param heater - нагреватель, мощность которого нужно изменить
+     *
+     * @param power - мощность (количество кадров, от нуля до frameCount)
+     */
+    void setPower(HeaterNum heater, Power power);
+
+    /**
+     * Устанавливает мощности нескольким нагревателям
+     *
+     * @note Небольшие изменения применяются по одному, как setPower(), а если сдвиг цепочек
+     *       обошёлся бы дороже, схема перестраивается один раз
+     *
+     * @param powers - пары (нагреватель, мощность)
+     */
+    void setPowers(const HeaterPowers& powers);
+
+    /**
+     * Возвращает мощность нагревателя, по которой построена схема
+     */
+    Power getPower(HeaterNum heater) const;
+
+    /**
+     * Возвращает true, если нагреватель должен быть включён в заданном кадре
+     */
+    bool isHeating(HeaterNum heater, Frame frame) const;
+
+    /**
+     * Возвращает количество кадров из [from, to), в которых нагреватель включён
+     *
+     * @note Вычисляется за O(1) по отрезку нагревателя
+     */
+    Power getHeatingFrames(HeaterNum heater, Frame from, Frame to) const;
+
+    /**
+     * Возвращает кадр нагревания с заданным номером
+     */
+    const HeatFrame& getFrame(Frame frame) const;
+
+    /**
+     * Возвращает битовый набор нагревателей, включённых в заданном кадре
+     *
+     * @note Содержит getWordsPerFrame() слов
+     */
+    const HeatFrameWord* getFrameWords(Frame frame) const;
+
+    /**
+     * Возвращает количество слов битового набора одного кадра
+     */
+    HeaterNum getWordsPerFrame() const;
+
+    /**
+     * Возвращает максимальное количество включенных нижних и верхних нагревателей
+     * @return first - четные, second - нечётные
+     */
+    std::pair<HeaterNum, HeaterNum> getMaximumEvenOddHeaters() const;
+
+    /**
+     * Возвращает максимальное количество включенных нижних и верхних нагревателей,
+     * которое получится, если установить нагревателю заданную мощность.
+     *
+     * @note Схема не изменяется и не копируется: изменения кадров
+     *       накапливаются в счётчиках на стеке поверх текущих счётчиков кадров
+     *
+     * @return first - четные, second - нечётные
+     */
+    std::pair<HeaterNum, HeaterNum> getMaximumEvenOddHeatersAfterPowerChange(HeaterNum heater, Power power) const;
+
+    /**
+     * Вычисляет getMaximumEvenOddHeatersAfterPowerChange() для каждого кандидата (нагреватель, мощность).
+     *
+     * Кандидаты обходятся по возрастанию номера нагревателя, а по пути накапливаются счётчики кадров
+     * начала каждой цепочки. Отрезки последующих нагревателей цепочки при изменении мощности
+     * сдвигаются как единая лента, поэтому их счётчики - это разность общих счётчиков и счётчиков
+     * начала цепочки, сдвинутая на изменение мощности. Один кандидат стоит O(количества кадров)
+     * независимо от количества нагревателей.
+     *
+     * @note Кандидат с несуществующим нагревателем или мощностью больше количества кадров
+     *       получает пики текущей схемы
+     *
+     * @param[out] peaks - пики для кандидатов в их порядке (first - чётные, second - нечётные)
+     *
+     * @param order - рабочий массив для порядка обхода кандидатов
+     *
+     * @note Память не выделяется, если ёмкости peaks и order хватает на все кандидаты
+     */
+    void getMaximumEvenOddHeatersAfterPowerChanges(const HeaterPowers& candidates,
+                                                  std::vector<std::pair<HeaterNum, HeaterNum>>& peaks,
+                                                  std::vector<std::size_t>& order) const;
+
+    /**
+     * Находит наибольшую мощность нагревателя из [0, limit], при которой пики чётных и нечётных
+     * нагревателей не превышают maxEven и maxOdd.
+     *
+     * @note Все мощности оцениваются по счётчикам кадров, как в getMaximumEvenOddHeatersAfterPowerChanges(),
+     *       без изменения и копирования схемы
+     *
+     * @return false, если ни одна мощность не укладывается в пределы
+     */
+    bool getMaximumAdmissiblePower(HeaterNum heater, HeaterNum maxEven, HeaterNum maxOdd,
+                                   Power& power, Power limit = MAX_FRAME_COUNT) const;
+
+    /**
+     * Распределяет суммарную мощность budget между нагревателями heaters
+     * так, чтобы пики не превышали maxEven и maxOdd.
+     *
+     * Мощности нагревателей набора сначала обнуляются, затем бюджет раздаётся
+     * по кругу равными долями (в порядке номеров нагревателей): каждый нагреватель получает
+     * допустимую мощность в пределах своей доли, остаток делится между теми, кто ещё может расти.
+     *
+     * Допустимая мощность ищется двоичным поиском по счётчикам кадров, а счётчики начала цепочек
+     * накапливаются одним проходом за круг: O(log(мощности) * кадры) на нагреватель и O(N * кадры) на круг.
+     * Пики в общем случае не монотонны по мощности (сдвиг последующих нагревателей может их уменьшить),
+     * поэтому найденная мощность допустима, но не обязательно наибольшая (см. getMaximumAdmissiblePower).
+     *
+     * @note Распределённые мощности устанавливаются в эту схему, поэтому для оценки
+     *       вызывается на копии
+     *
+     * @param[out] powers - мощности нагревателей набора в его порядке
+     *        (некорректные и повторные нагреватели пропускаются)
+     *
+     * @return распределённая мощность (не больше budget)
+     */
+    std::uint32_t distributePowerBudget(const std::vector<HeaterNum>& heaters, std::uint32_t budget,
+                                        HeaterNum maxEven, HeaterNum maxOdd, HeaterPowers& powers);
+
+    /**
+     * Задаёт группы нагрузки и пересчитывает их счётчики
+     *
+     * @param groupsCount - количество групп
+     *
+     * @param memberships - группы каждого нагревателя (нагреватели за концом набора не входят ни в одну)
+     *
+     * @return false, если номер группы или нагревателя некорректен (группы не изменяются)
+     */
+    bool setGroups(GroupNum groupsCount, const GroupMemberships& memberships);
+
+    GroupNum getGroupsCount() const;
+
+    /**
+     * Возвращает счётчики включённых нагревателей групп в кадре (getGroupsCount() значений)
+     */
+    const HeaterNum* getGroupCounts(Frame frame) const;
+
+    /**
+     * Вычисляет максимальное количество одновременно включённых нагревателей каждой группы
+     *
+     * @param[out] peaks - пики групп (getGroupsCount() значений)
+     */
+    void getMaximumGroupHeaters(std::vector<HeaterNum>& peaks) const;
+
+    /**
+     * Вычисляет пики групп, которые получатся, если установить нагревателю заданную мощность
+     *
+     * @note Как и getMaximumEvenOddHeatersAfterPowerChange(), накапливает изменения кадров
+     *       поверх текущих счётчиков, не изменяя схему
+     *
+     * @param[out] peaks - пики групп (getGroupsCount() значений)
+     *
+     * @param diff - рабочий массив изменений счётчиков (память не выделяется,
+     *        если его ёмкость не меньше количества кадров * количества групп)
+     */
+    void getMaximumGroupHeatersAfterPowerChange(HeaterNum heater, Power power, std::vector<HeaterNum>& peaks,
+                                                std::vector<int>& diff) const;
+
+private:
+    /**
+     * Счётчики нагревателей по кадрам
+     */
+    typedef int FrameCounters[MAX_FRAME_COUNT];
+
+private:
+    /**
+     * Возвращает алгоритм раскладки по цепочкам для размеров этой схемы
+     */
+    HeatChains _chains() const;
+
+    /**
+     * Заполняет общие счётчики чётных [0] и нечётных [1] нагревателей текущей схемы
+     */
+    void _countTotals(FrameCounters total[2]) const;
+
+    /**
+     * Добавляет в счётчики начала цепочек prefix[цепочка][чётность] нагреватели [swept, heater]
+     * и сдвигает swept за heater
+     */
+    void _sweepChains(HeaterNum heater, FrameCounters prefix[2][2], HeaterNum& swept) const;
+
+    /**
+     * Двоичным поиском находит допустимую мощность нагревателя из (from, to]
+     *
+     * @return from, если допустимая мощность не найдена
+     */
+    Power _searchAdmissiblePower(const FrameCounters total[2], const FrameCounters prefix[2][2], HeaterNum heater,
+                                 Power from, Power to, HeaterNum maxEven, HeaterNum maxOdd) const;
+
+    /**
+     * Вычисляет пики после установки мощности нагревателю по общим счётчикам
+     * и счётчикам начала цепочек, накопленным по нагреватель включительно
+     */
+    std::pair<HeaterNum, HeaterNum> _peaksAfterChange(const FrameCounters total[2], const FrameCounters prefix[2][2],
+                                                      HeaterNum heater, Power power) const;
+
+    /**
+     * Полностью перестраивает схему по текущим мощностям
+     */
+    void _rebuild();
+
+    /**
+     * Пересчитывает счётчики групп по отрезкам нагревателей
+     */
+    void _countGroups();
+
+    /**
+     * Изменяет счётчики групп нагревателя в count кадрах подряд, начиная с кадра from
+     */
+    void _changeGroupCounts(HeaterNum heater, Frame from, Power count, int change);
+
+    /**
+     * Изменяет счётчики кадров и групп нагревателя в count кадрах подряд, начиная с кадра from
+     *
+     * @param add - нагреватель добавлен в кадры (true) или удалён из них
+     */
+    void _countFrames(HeaterNum heater, Frame from, Power count, bool add);
+
+private:
+    Frame _frameCount;
+    /**
+     * Шаг между соседними нагревателями цепочки раскладки
+     */
+    HeaterNum _chainStep;
+    std::vector<Power> _powers;
+    /**
+     * Начальный кадр отрезка каждого нагревателя
+     */
+    std::vector<Frame> _starts;
+    std::vector<HeatFrame> _frames;
+    HeaterNum _wordsPerFrame;
+    /**
+     * Битовые наборы кадров: _frameWords[frame * _wordsPerFrame + heater / HEAT_FRAME_WORD_BITS]
+     */
+    std::vector<HeatFrameWord> _frameWords;
+
+    GroupNum _groupsCount = 0;
+    /**
+     * Группы нагревателя heater: _groupMembers[_groupOffsets[heater] .. _groupOffsets[heater + 1])
+     */
+    std::vector<std::size_t> _groupOffsets;
+    std::vector<GroupNum> _groupMembers;
+    /**
+     * _groupCounts[frame * _groupsCount + group]
+     */
+    std::vector<HeaterNum> _groupCounts;
+    /**
+     * Номер нагревателя в наборе distributePowerBudget + 1 (0 - не входит в набор)
+     */
+    std::vector<std::uint32_t> _budgetSlots;
+};
+
+#endif //HEATERS_HEAT_SCHEDULE_H
@@ -0,0 +1,22 @@
+#include "heat_setter_sink.h"
+
+#include <algorithm>
+
+HeatSetterSink::HeatSetterSink(HeaterNum heatersNum, HeatSetter setHeaterStateFn)
+        : _heatersNum(heatersNum), _setHeaterState(std::move(setHeaterStateFn)) {
+}
+
+void HeatSetterSink::setStates(const HeatStateWord* states, const HeatStateWord*, std::size_t wordsCount) {
+    for(std::size_t word = 0; word < wordsCount; ++word) {
+        _setWord(states, static_cast<HeaterNum>(word));
+    }
+}
+
+void HeatSetterSink::_setWord(const HeatStateWord* states, HeaterNum word) {
+    HeaterNum first = word * HEAT_STATE_WORD_BITS;
+    HeaterNum last = std::min(first + HEAT_STATE_WORD_BITS, _heatersNum);
+
+    for(HeaterNum heaterNum = first; heaterNum < last; ++heaterNum) {
+        _setHeaterState(heaterNum, (states[word] >> (heaterNum - first)) & 1u);
+    }
+}
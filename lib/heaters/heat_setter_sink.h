@@ -0,0 +1,41 @@
+#ifndef HEATERS_HEAT_SETTER_SINK_H
+#define HEATERS_HEAT_SETTER_SINK_H
+
+#include <cstddef>
+
+#include "variables_description.h"
+#include "heat_sink.h"
+#include "heater.h"
+
+/**
+ * Адаптер приёмника к функции установки состояния отдельного нагревателя.
+ *
+ * Сохраняет прежний контракт HeatSetter: функция вызывается каждый полупериод
+ * для каждого нагревателя, в т.ч. для нагревателей без мощности (false).
+ * Поэтому список активных слов адаптером не используется (setActiveStates передаёт все слова
+ * в setStates): обход только активных слов доступен приёмникам IHeatSink.
+ */
+class HeatSetterSink : public IHeatSink {
+public:
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param setHeaterStateFn - функция для установки состояния нагревателя
+     */
+    HeatSetterSink(HeaterNum heatersNum, HeatSetter setHeaterStateFn);
+
+    void setStates(const HeatStateWord* states, const HeatStateWord* changed,
+                   std::size_t wordsCount) override;
+
+private:
+    /**
+     * Вызывает функцию для нагревателей слова word
+     */
+    void _setWord(const HeatStateWord* states, HeaterNum word);
+
+private:
+    HeaterNum _heatersNum;
+    HeatSetter _setHeaterState;
+};
+
+#endif //HEATERS_HEAT_SETTER_SINK_H
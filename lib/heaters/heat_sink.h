@@ -0,0 +1,55 @@
+#ifndef HEATERS_HEAT_SINK_H
+#define HEATERS_HEAT_SINK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "variables_description.h"
+
+/**
+ * Слово упакованных состояний нагревателей:
+ * бит (heater % HEAT_STATE_WORD_BITS) слова (heater / HEAT_STATE_WORD_BITS)
+ */
+typedef std::uint32_t HeatStateWord;
+
+static const HeaterNum HEAT_STATE_WORD_BITS = 32;
+
+/**
+ * Приёмник состояний нагревателей.
+ *
+ * Вызывается один раз в полупериод и получает состояния всех нагревателей
+ * упакованными в 32-битные слова (по слову на 32 нагревателя, как в регистрах портов вывода),
+ * а также маску нагревателей, состояние которых изменилось с прошлого полупериода.
+ */
+class IHeatSink {
+public:
+    virtual ~IHeatSink() = default;
+
+    /**
+     * @param states - упакованные состояния нагревателей (1 - включён)
+     *
+     * @param changed - упакованная маска нагревателей, состояние которых изменилось
+     *
+     * @param wordsCount - количество слов в states и changed
+     */
+    virtual void setStates(const HeatStateWord* states, const HeatStateWord* changed,
+                           std::size_t wordsCount) = 0;
+
+    /**
+     * Вызывается модулем вместо setStates вместе со списком активных слов - слов,
+     * в которых есть нагреватели с ненулевой мощностью или изменившимся состоянием.
+     * Остальные слова states и changed нулевые.
+     *
+     * @note По умолчанию передаёт все слова в setStates
+     *
+     * @param activeWords - номера активных слов в произвольном порядке
+     *
+     * @param activeCount - количество активных слов
+     */
+    virtual void setActiveStates(const HeatStateWord* states, const HeatStateWord* changed,
+                                 std::size_t wordsCount, const HeaterNum*, std::size_t) {
+        setStates(states, changed, wordsCount);
+    }
+};
+
+#endif //HEATERS_HEAT_SINK_H
@@ -1,7 +1,6 @@
 #include "heater.h"
 
-Heater::Heater() : _log(TIME_LIMIT, 0) {
-}
+Heater::Heater() = default;
 
 void Heater::setPower(Power power) {
     if(power > MAXIMUM_POWER) return;
@@ -9,38 +8,24 @@ void Heater::setPower(Power power) {
     _power = power;
 }
 
-Power Heater::getPower(unsigned short timeOffset) const {
-    if(timeOffset < TIME_LIMIT) {
-        if(timeOffset == 0) {
-            return _log.front();
-        } else {
-            return _log[timeOffset];
-        }
-    } else {
-        return 0;
-    }
+bool Heater::countTurnOn() {
+    return _setTrueStateCount++ == 0;
 }
 
-void Heater::setState(bool state) {
-    _lastState = _state;
-
-    if(state != _state)
-        _state = state;
+bool Heater::countTurnOns(Power count) {
+    bool first = _setTrueStateCount == 0 && count > 0;
 
-    if(state) {
-        ++_setTrueStateCount;
-    }
-}
+    _setTrueStateCount += count;
 
-bool Heater::getLastState() const {
-    return _lastState;
+    return first;
 }
 
-void Heater::update() {
-    _log.push_front(_setTrueStateCount);
-    _log.pop_back();
+Power Heater::update() {
+    Power secondPower = _setTrueStateCount;
 
     _setTrueStateCount = 0;
+
+    return secondPower;
 }
 
 Power Heater::getCurrentPower() const {
@@ -1,7 +1,6 @@
 #ifndef HEATERS_HEATER_H
 #define HEATERS_HEATER_H
 
-#include <deque>
 #include <functional>
 
 #include "variables_description.h"
@@ -15,74 +14,59 @@ public:
     /**
      * Устанавливает заданную мощность на нагреватель.
      *
-     * @note Обновление текущей мощности происходит только при вызове метода _update().
-     *       Если до вызова _update() мощность устанавливалась несколько раз,
-     *       в нагреватель будет установлена округленное среднее значение всех установленных мощностей.
+     * @note Мощность начинает действовать сразу; мощность, фактически выделенная за секунду,
+     *       определяется количеством включений (countTurnOn) и возвращается из update().
      *
      * @param power - устанавливаемая мощность в процентах (от нуля до 100)
      */
     void setPower(Power power);
 
-    /**
-     * Возвращает текущую мощность нагревателя или мощность установленную в прошлом.
-     *
-     * @note - хранит историю за последние 10 минут (600 секунд)
-     *
-     * @note - не учитывает текущую (т.е. ещё не завершённую) секунду
-     *
-     * @param timeOffset - момент времени, для которого
-     * 		  запрашивается мощность (0: текущая мощность, -1: мощность,
-     * 		  которая была на нагревателе одну секунду назад и т.д.)
-     */
-    Power getPower(unsigned short timeOffset = 0) const;
-
     /**
      * Возвращает мощность установленную в текущий полупериод
      */
     Power getCurrentPower() const;
 
     /**
-     * Устанавливает заданное состояние на нагреватель
+     * Учитывает включение нагревателя в текущем полупериоде
+     *
+     * @note Состояния нагревателей хранятся упакованными в модуле Heaters,
+     *       нагреватель только считает свои включения за секунду
      *
-     * @param state - устанавливаемое состояние
+     * @return true, если это первое включение за секунду
      */
-    void setState(bool state);
+    bool countTurnOn();
 
     /**
-     * Возвращает состояние нагревателя в прошлый полупериод
+     * Учитывает включения нагревателя сразу в нескольких полупериодах
+     *
+     * @return true, если это первые включения за секунду
      */
-    bool getLastState() const;
+    bool countTurnOns(Power count);
 
     /**
-     * Данный метод служит для обновления:
-     *    - обновление истории устанавливаемых мощностей.
+     * Данный метод служит для завершения секунды:
+     *    - сбрасывает счётчик включений нагревателя.
      *
      * @note Данный метод необходимо 1 раз в 1 секунду
+     *
+     * @return мощность, выделенная за завершившуюся секунду
+     *         (для записи в историю мощностей)
      */
-    void update();
+    Power update();
 
-private:
+public:
     /**
      * Максимально возможная мощность в процентах
      */
-    static const short MAXIMUM_POWER = 100;
-    /**
-     * Максимальный лимит времени хранения истории мощности
-     *
-     * @note Единицы измерения - секунда
-     */
-    static const short TIME_LIMIT = 600;
+    static const short MAXIMUM_POWER = MAXIMUM_HEATER_POWER;
 
 private:
     Power _power = 0;
     /**
-     * Количество включений нагревателей за 1 секунду
-     * @note Количество вызовов функции HeatSetter с аргументом True
+     * Количество включений нагревателя за текущую секунду
+     * @note Увеличивается в countTurnOn() и countTurnOns(), сбрасывается в update()
      */
     short _setTrueStateCount = 0;
-    bool _state = false;
-    bool _lastState = false;
-    std::deque<Power> _log;
 };
 
 #endif //HEATERS_HEATER_H
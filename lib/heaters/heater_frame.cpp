@@ -1,26 +1,35 @@
 #include "heater_frame.h"
 
-void HeatFrame::addHeater(const HeaterNum &heater) {
-    _heaters.push_back(heater);
+#include "bit_operations.h"
 
+void HeatFrame::addHeater(const HeaterNum &heater) {
     if(heater % 2 == 0)
         ++_evenHeatersCount;
     else
         ++_oddHeatersCount;
 }
 
-short HeatFrame::getEvenHeatersCount() const {
-    return _evenHeatersCount;
+void HeatFrame::removeHeater(const HeaterNum &heater) {
+    if(heater % 2 == 0)
+        --_evenHeatersCount;
+    else
+        --_oddHeatersCount;
 }
 
-short HeatFrame::getOddHeatersCount() const {
-    return _oddHeatersCount;
+void HeatFrame::countHeaters(const HeatFrameWord* words, HeaterNum wordsCount) {
+    _evenHeatersCount = 0;
+    _oddHeatersCount = 0;
+
+    for(HeaterNum word = 0; word < wordsCount; ++word) {
+        _evenHeatersCount += popCount(words[word] & EVEN_HEATERS_MASK);
+        _oddHeatersCount += popCount(words[word] & ODD_HEATERS_MASK);
+    }
 }
 
-std::vector<HeaterNum>::iterator HeatFrame::begin() {
-    return _heaters.begin();
+HeaterNum HeatFrame::getEvenHeatersCount() const {
+    return _evenHeatersCount;
 }
 
-std::vector<HeaterNum>::iterator HeatFrame::end() {
-    return _heaters.end();
+HeaterNum HeatFrame::getOddHeatersCount() const {
+    return _oddHeatersCount;
 }
\ No newline at end of file
@@ -1,10 +1,28 @@
 #ifndef HEATERS_HEATER_FRAME_H
 #define HEATERS_HEATER_FRAME_H
 
-#include <vector>
+#include <cstdint>
 
 #include "variables_description.h"
-#include "heater.h"
+
+/**
+ * Слово битового набора нагревателей кадра:
+ * бит (heater % HEAT_FRAME_WORD_BITS) слова (heater / HEAT_FRAME_WORD_BITS)
+ */
+typedef std::uint64_t HeatFrameWord;
+
+static const HeaterNum HEAT_FRAME_WORD_BITS = 64;
+
+/**
+ * Маска верхних (чётных) нагревателей в слове битового набора.
+ * Слово начинается с чётного номера, поэтому чётным нагревателям соответствуют чётные биты
+ */
+static const HeatFrameWord EVEN_HEATERS_MASK = 0x5555555555555555ull;
+
+/**
+ * Маска нижних (нечётных) нагревателей в слове битового набора
+ */
+static const HeatFrameWord ODD_HEATERS_MASK = ~EVEN_HEATERS_MASK;
 
 /**
  * Для обеспечения включения нагревателей определенное количество раз за секунду (в соответствии с мощностью)
@@ -14,10 +32,12 @@
  * vector<HeatFrame> heat_frames;
  *
  * Каждый элемент этого вектора содержит HeatFrame
- * HeatFrame - хранит номера нагревателей, которые должны быть включены в данный полупериод.
+ * HeatFrame - хранит количество верхних (чётных) и нижних (нечётных) нагревателей,
+ * которые должны быть включены в данный полупериод.
  *
- * Тогда при обращении к элементу вектора кадров с индексом равным необходимому полупериоду
- * получим номера включенных в данный момент времени нагревателей
+ * Какие именно нагреватели включены в кадре, хранит схема нагревания (HeatSchedule)
+ * в виде плотного битового набора слов HeatFrameWord на каждый кадр,
+ * кадр лишь поддерживает счётчики в согласованном состоянии при добавлении и удалении нагревателей.
  */
 class HeatFrame {
 public:
@@ -25,19 +45,24 @@ public:
 
     void addHeater(const HeaterNum& heater);
 
-    short getEvenHeatersCount() const;
+    void removeHeater(const HeaterNum& heater);
 
-    short getOddHeatersCount() const;
+    /**
+     * Пересчитывает счётчики по битовому набору нагревателей кадра
+     *
+     * @param words - слова битового набора
+     *
+     * @param wordsCount - количество слов
+     */
+    void countHeaters(const HeatFrameWord* words, HeaterNum wordsCount);
 
-    std::vector<HeaterNum>::iterator begin();
+    HeaterNum getEvenHeatersCount() const;
 
-    std::vector<HeaterNum>::iterator end();
+    HeaterNum getOddHeatersCount() const;
 
 private:
-    std::vector<HeaterNum> _heaters;
-
-    short _evenHeatersCount = 0;
-    short _oddHeatersCount = 0;
+    HeaterNum _evenHeatersCount = 0;
+    HeaterNum _oddHeatersCount = 0;
 };
 
 #endif //HEATERS_HEATER_FRAME_H
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "heater_zones.h"
+
+#include <algorithm>
+
+HeaterZones::HeaterZones(unsigned workersCount)
+        : _workersCount(std::max(workersCount, 1u)), _shards(new Shard[_workersCount]),
+          _deadline(HeatersMetrics::DEFAULT_DEADLINE) {
+    for(unsigned worker = 1; worker < _workersCount; ++worker) {
+        _workers.emplace_back(&HeaterZones::_work, this, worker);
+    }
+}
+
+HeaterZones::~HeaterZones() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _started.notify_all();
+
+    for(auto& worker: _workers) worker.join();
+}
+
+std::size_t HeaterZones::addZone(HeaterNum heatersNum, IHeatSink& sink, ScheduleLayout layout) {
+    _zones.push_back(std::make_unique<Heaters>(heatersNum, sink, layout));
+
+    return _zones.size() - 1;
+}
+
+std::size_t HeaterZones::addZone(HeaterNum heatersNum, HeatSetter setHeaterStateFn, ScheduleLayout layout) {
+    _zones.push_back(std::make_unique<Heaters>(heatersNum, std::move(setHeaterStateFn), layout));
+
+    return _zones.size() - 1;
+}
+
+Heaters& HeaterZones::getZone(std::size_t zone) {
+    return *_zones[zone];
+}
+
+std::size_t HeaterZones::getZonesCount() const {
+    return _zones.size();
+}
+
+bool HeaterZones::zeroCrossed() {
+    auto start = std::chrono::steady_clock::now();
+    std::uint32_t generation;
+
+    _remaining.store(_zones.size(), std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        generation = ++_generation;
+
+        // Равные части зон по участникам
+        for(unsigned worker = 0; worker < _workersCount; ++worker) {
+            std::size_t begin = _zones.size() * worker / _workersCount;
+
+            _shards[worker].end.store(_zones.size() * (worker + 1) / _workersCount, std::memory_order_relaxed);
+            _shards[worker].next.store(static_cast<std::uint64_t>(generation) << 32 | begin,
+                                       std::memory_order_release);
+        }
+    }
+
+    _started.notify_all();
+
+    _run(0, generation);
+
+    while(_remaining.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+    }
+
+    if(std::chrono::steady_clock::now() - start <= _deadline) return true;
+
+    _deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+
+    return false;
+}
+
+void HeaterZones::getMaxNumOfTurnedHeaters(unsigned int& top, unsigned int& bot) const {
+    top = 0;
+    bot = 0;
+
+    if(_zones.empty()) return;
+
+    Frame frameCount = _zones.front()->getFrameCount();
+
+    for(Frame step = 0; step < frameCount; ++step) {
+        unsigned int frameTop = 0;
+        unsigned int frameBot = 0;
+
+        for(const auto& zone: _zones) {
+            auto turned = zone->getTurnedHeaters((zone->getCurrentFrame() + step) % frameCount);
+
+            frameTop += turned.first;
+            frameBot += turned.second;
+        }
+
+        top = std::max(top, frameTop);
+        bot = std::max(bot, frameBot);
+    }
+}
+
+void HeaterZones::setDeadline(std::chrono::nanoseconds deadline) {
+    _deadline = deadline;
+}
+
+std::uint64_t HeaterZones::getDeadlineMisses() const {
+    return _deadlineMisses.load(std::memory_order_relaxed);
+}
+
+void HeaterZones::_work(unsigned worker) {
+    std::uint32_t seen = 0;
+
+    for(;;) {
+        std::uint32_t generation;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _started.wait(lock, [this, seen]() { return _stopping || _generation != seen; });
+
+            if(_stopping) return;
+
+            generation = seen = _generation;
+        }
+
+        _run(worker, generation);
+    }
+}
+
+void HeaterZones::_run(unsigned worker, std::uint32_t generation) {
+    std::size_t zone;
+
+    // Сначала свои зоны, затем чужие по кругу
+    for(unsigned offset = 0; offset < _workersCount; ++offset) {
+        Shard& shard = _shards[(worker + offset) % _workersCount];
+
+        while(_take(shard, generation, zone)) {
+            _zones[zone]->zeroCrossed();
+            _remaining.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+bool HeaterZones::_take(Shard& shard, std::uint32_t generation, std::size_t& zone) {
+    std::uint64_t next = shard.next.load(std::memory_order_acquire);
+
+    for(;;) {
+        if(static_cast<std::uint32_t>(next >> 32) != generation) return false;
+
+        zone = static_cast<std::size_t>(next & 0xFFFFFFFFu);
+
+        if(zone >= shard.end.load(std::memory_order_relaxed)) return false;
+
+        if(shard.next.compare_exchange_weak(next, next + 1, std::memory_order_acq_rel)) return true;
+    }
+}
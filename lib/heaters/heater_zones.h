@@ -0,0 +1,145 @@
+#ifndef HEATERS_HEATER_ZONES_H
+#define HEATERS_HEATER_ZONES_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "variables_description.h"
+#include "heaters.h"
+
+/**
+ * Несколько независимых зон нагревателей (по модулю Heaters на зону),
+ * полупериоды которых выполняются параллельно пулом потоков.
+ *
+ * На каждом переходе через ноль зоны делятся на равные части по участникам пула
+ * (вызывающий поток - тоже участник). Участник выполняет свои зоны, а затем
+ * забирает ещё не начатые зоны других участников (work stealing), поэтому медленная
+ * зона или вытесненный поток не задерживают остальные зоны.
+ * zeroCrossed() возвращает управление, когда все зоны выполнили полупериод,
+ * т.е. все приёмники состояний уже вызваны; ежесекундное обновление каждой зоны
+ * выполняется там же, в её полупериоде.
+ *
+ * @note Зоны добавляются и мощности устанавливаются из потока, вызывающего zeroCrossed(),
+ *       между его вызовами. Приёмники состояний вызываются из потоков пула.
+ */
+class HeaterZones {
+public:
+    /**
+     * @param workersCount - количество участников пула, включая вызывающий поток
+     */
+    explicit HeaterZones(unsigned workersCount = std::thread::hardware_concurrency());
+
+    ~HeaterZones();
+
+    HeaterZones(const HeaterZones&) = delete;
+    HeaterZones& operator=(const HeaterZones&) = delete;
+
+    /**
+     * Добавляет зону
+     *
+     * @return номер зоны
+     */
+    std::size_t addZone(HeaterNum heatersNum, IHeatSink& sink,
+                        ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    std::size_t addZone(HeaterNum heatersNum, HeatSetter setHeaterStateFn,
+                        ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    Heaters& getZone(std::size_t zone);
+
+    std::size_t getZonesCount() const;
+
+    /**
+     * Выполняет полупериод всех зон
+     *
+     * @return false, если полупериод всех зон не уложился в срок
+     */
+    bool zeroCrossed();
+
+    /**
+     * Вычисляет максимальное количество одновременно работающих верхних и нижних
+     * нагревателей всех зон в ближайшую секунду
+     *
+     * @note Учитывает, что зоны, добавленные в разное время, находятся в разных
+     *       полупериодах секунды
+     */
+    void getMaxNumOfTurnedHeaters(unsigned int& top, unsigned int& bot) const;
+
+    /**
+     * Устанавливает срок выполнения полупериода всех зон
+     */
+    void setDeadline(std::chrono::nanoseconds deadline);
+
+    /**
+     * Количество полупериодов, не уложившихся в срок
+     */
+    std::uint64_t getDeadlineMisses() const;
+
+private:
+    /**
+     * Зоны участника пула, ещё не взятые в работу.
+     *
+     * Позиция хранится вместе с номером полупериода: участник, опоздавший
+     * к прошлому полупериоду, не может забрать зону следующего
+     */
+    struct Shard {
+        /**
+         * Номер полупериода (старшие 32 бита) и номер следующей зоны (младшие)
+         */
+        std::atomic<std::uint64_t> next{0};
+        std::atomic<std::size_t> end{0};
+        /**
+         * Разделяет позиции участников по строкам кэша
+         */
+        char padding[64];
+    };
+
+private:
+    /**
+     * Цикл потока пула
+     */
+    void _work(unsigned worker);
+
+    /**
+     * Выполняет зоны участника, а затем зоны других участников
+     */
+    void _run(unsigned worker, std::uint32_t generation);
+
+    /**
+     * Забирает следующую зону участника shard
+     *
+     * @return false, если зон не осталось
+     */
+    bool _take(Shard& shard, std::uint32_t generation, std::size_t& zone);
+
+private:
+    std::vector<std::unique_ptr<Heaters>> _zones;
+    unsigned _workersCount;
+    std::unique_ptr<Shard[]> _shards;
+    std::vector<std::thread> _workers;
+
+    std::mutex _mutex;
+    std::condition_variable _started;
+    /**
+     * Номер текущего полупериода, защищён _mutex
+     */
+    std::uint32_t _generation = 0;
+    bool _stopping = false;
+
+    /**
+     * Количество зон, ещё не выполнивших текущий полупериод
+     */
+    std::atomic<std::size_t> _remaining{0};
+
+    std::chrono::nanoseconds _deadline;
+    std::atomic<std::uint64_t> _deadlineMisses{0};
+};
+
+#endif //HEATERS_HEATER_ZONES_H
@@ -1,5 +1,11 @@
 #include "heaters.h"
 
+#include <algorithm>
+
+#include "bit_operations.h"
+#include "heat_setter_sink.h"
+#include "schedule_builder.h"
+
 /**
  * Принцип управления мощностью:
  * Если нужно подать 40% мощности на нагреватель,
@@ -17,37 +23,220 @@
  * (лишь бы он был включён ровно 40 полупериодов из 100)
  */
 
-Heaters::Heaters(HeaterNum heatersNum, HeatSetter setHeaterStateFn)
-        : _heaters(heatersNum), _setHeaterState(std::move(setHeaterStateFn)), _heatFrames(FRAME_COUNT) {
-    //Устанавливаем начальное состояние нагревателей - выкл
-    for(HeaterNum num = 0; num < heatersNum; ++num) {
-        _heatersNumToState[num] = false;
+Heaters::Heaters(HeaterNum heatersNum, HeatSetter setHeaterStateFn, ScheduleLayout layout)
+        : Heaters(heatersNum, nullptr, std::make_unique<HeatSetterSink>(heatersNum, std::move(setHeaterStateFn)),
+                  layout) {
+}
+
+Heaters::Heaters(HeaterNum heatersNum, IHeatSink& sink, ScheduleLayout layout)
+        : Heaters(heatersNum, &sink, nullptr, layout) {
+}
+
+Heaters::Heaters(HeaterNum heatersNum, IHeatSink* sink, std::unique_ptr<IHeatSink> ownedSink,
+                 ScheduleLayout layout)
+        : _heaters(heatersNum), _ownedSink(std::move(ownedSink)), _sink(sink ? sink : _ownedSink.get()),
+          _history(heatersNum),
+          _schedule(heatersNum, FRAME_COUNT, layout),
+          _pendingSchedule(heatersNum, FRAME_COUNT, layout),
+          _isPendingChange(heatersNum, 0),
+          _scratchSchedule(heatersNum, FRAME_COUNT, layout),
+          //Устанавливаем начальное состояние нагревателей - выкл
+          _states((heatersNum + HEAT_STATE_WORD_BITS - 1) / HEAT_STATE_WORD_BITS, 0),
+          _changedStates(_states.size(), 0),
+          _poweredInWord(_states.size(), 0),
+          _isActiveWord(_states.size(), 0) {
+    _candidatesOrder.reserve(CANDIDATES_CAPACITY);
+    _turnedOn.reserve(heatersNum);
+    _activeWords.reserve(_states.size());
+    _pendingChanges.reserve(heatersNum);
+    _builtChanges.reserve(heatersNum);
+}
+
+Heaters::~Heaters() = default;
+
+HistoryFile Heaters::attachHistoryFile(const std::string& path) {
+    HistoryFile result = _history.attachFile(path);
+
+    if(result != HistoryFile::RESTORED) return result;
+
+    HeaterPowers powers;
+    powers.reserve(_heaters.size());
+
+    for(HeaterNum heaterNum = 0; heaterNum < _heaters.size(); ++heaterNum) {
+        Power power = _history.getStoredPower(heaterNum);
+
+        _heaters[heaterNum].setPower(power);
+        powers.emplace_back(heaterNum, _heaters[heaterNum].getCurrentPower());
     }
+
+    _schedule.setPowers(powers);
+    _hasPendingSchedule = false;
+    _countPowered();
+
+    if(_mirror.isOpen()) _mirror.storePowers(_schedule);
+
+    return result;
+}
+
+bool Heaters::attachStateMirror(const std::string& name) {
+    if(!_mirror.open(name, static_cast<HeaterNum>(_heaters.size()))) return false;
+
+    _mirror.storePowers(_schedule);
+    _publishMirror();
+
+    return true;
 }
 
 void Heaters::setPower(HeaterNum heater, Power power) {
+    if(_builder) {
+        if(heater < _heaters.size() && power <= Heater::MAXIMUM_POWER) _builder->request(heater, power);
+        return;
+    }
+
+    HeatersMetrics::Scope scope(_metrics.scheduleUpdate());
+
+    Power oldPower = _heaters[heater].getCurrentPower();
+
     _heaters[heater].setPower(power);
-    _updateHeatFrames();
+    _schedule.setPower(heater, _heaters[heater].getCurrentPower());
+    _updatePowered(heater, oldPower, _heaters[heater].getCurrentPower());
+    _history.storePower(heater, _heaters[heater].getCurrentPower());
+
+    if(_mirror.isOpen()) _mirror.storePower(heater, _heaters[heater].getCurrentPower());
+
+    // Не теряем мощность при вступлении в силу отложенной схемы
+    if(_hasPendingSchedule) {
+        _pendingSchedule.setPower(heater, _heaters[heater].getCurrentPower());
+    }
 }
 
-void Heaters::_updateHeatFrames() {
-    _heatFrames = std::move(_getHeatFrames(_heaters));
+bool Heaters::setPowers(const HeaterPowers& powers, PowersCommit commit) {
+    for(const auto& heaterAndPower: powers) {
+        if(heaterAndPower.first >= _heaters.size() || heaterAndPower.second > Heater::MAXIMUM_POWER) {
+            return false;
+        }
+    }
+
+    if(_builder) {
+        _builder->request(powers, commit);
+        return true;
+    }
+
+    HeatersMetrics::Scope scope(_metrics.scheduleUpdate());
+
+    // Новый набор строится поверх ещё не вступившего в силу
+    if(!_hasPendingSchedule) {
+        _pendingSchedule = _schedule;
+    }
+
+    _pendingSchedule.setPowers(powers);
+    _hasPendingSchedule = true;
+    _pendingCommit = commit;
+
+    for(const auto& heaterAndPower: powers) {
+        _markPendingChange(heaterAndPower.first);
+    }
+
+    return true;
 }
 
 void Heaters::getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum heater,Power power,
                                                        unsigned int &top, unsigned int &bot) {
-    std::vector<Heater> heaters = _heaters;
-
-    heaters[heater].setPower(power);
+    if(power > Heater::MAXIMUM_POWER) {
+        power = _schedule.getPower(heater);
+    }
 
-    auto heatFrames = std::move(_getHeatFrames(heaters));
-    auto evenOddHeaters = _getMaximumEvenOddHeaters(heatFrames);
+    auto evenOddHeaters = _schedule.getMaximumEvenOddHeatersAfterPowerChange(heater, power);
 
     top = evenOddHeaters.first;
     bot = evenOddHeaters.second;
 }
 
+void Heaters::getMaxNumOfTurnedHeatersAfterPowerChanges(const HeaterPowers& candidates,
+                                                        std::vector<std::pair<HeaterNum, HeaterNum>>& peaks) {
+    _schedule.getMaximumEvenOddHeatersAfterPowerChanges(candidates, peaks, _candidatesOrder);
+}
+
+void Heaters::startScheduleBuilder(PowersCommit policy) {
+    if(_builder) return;
+
+    _builder = std::make_unique<ScheduleBuilder>(static_cast<HeaterNum>(_heaters.size()), _schedule, policy);
+
+    if(!_hasPendingSchedule) return;
+
+    HeaterPowers powers;
+
+    for(HeaterNum heaterNum = 0; heaterNum < _heaters.size(); ++heaterNum) {
+        if(_pendingSchedule.getPower(heaterNum) != _schedule.getPower(heaterNum)) {
+            powers.emplace_back(heaterNum, _pendingSchedule.getPower(heaterNum));
+        }
+    }
+
+    _builder->request(powers, _pendingCommit);
+    _hasPendingSchedule = false;
+
+    for(HeaterNum heaterNum: _pendingChanges) {
+        _isPendingChange[heaterNum] = false;
+    }
+
+    _pendingChanges.clear();
+}
+
+void Heaters::stopScheduleBuilder() {
+    if(!_builder) return;
+
+    _builder->wait();
+    _hasPendingSchedule = _builder->take(_pendingSchedule, _pendingCommit, _builtChanges);
+    _builder.reset();
+
+    if(!_hasPendingSchedule) return;
+
+    for(HeaterNum heaterNum: _builtChanges) {
+        _markPendingChange(heaterNum);
+    }
+}
+
+void Heaters::waitScheduleBuilder() {
+    if(_builder) _builder->wait();
+}
+
+bool Heaters::setLoadGroups(GroupNum groupsCount, const GroupMemberships& memberships) {
+    if(_builder) return false;
+
+    if(!_schedule.setGroups(groupsCount, memberships)) return false;
+
+    _pendingSchedule.setGroups(groupsCount, memberships);
+    _scratchSchedule.setGroups(groupsCount, memberships);
+    _groupsDiff.reserve(static_cast<std::size_t>(FRAME_COUNT) * groupsCount);
+
+    return true;
+}
+
+void Heaters::getMaxNumOfTurnedHeatersInGroups(std::vector<HeaterNum>& peaks) {
+    _schedule.getMaximumGroupHeaters(peaks);
+}
+
+void Heaters::getMaxNumOfTurnedHeatersInGroupsAfterPowerChange(HeaterNum heater, Power power,
+                                                               std::vector<HeaterNum>& peaks) {
+    _schedule.getMaximumGroupHeatersAfterPowerChange(heater, power, peaks, _groupsDiff);
+}
+
+bool Heaters::getMaxAdmissiblePower(HeaterNum heater, unsigned int top, unsigned int bot, Power& power) {
+    return _schedule.getMaximumAdmissiblePower(heater, top, bot, power, Heater::MAXIMUM_POWER);
+}
+
+std::uint32_t Heaters::distributePowerBudget(const std::vector<HeaterNum>& heaters, std::uint32_t budget,
+                                             unsigned int top, unsigned int bot, HeaterPowers& powers) {
+    _scratchSchedule = _schedule;
+
+    return _scratchSchedule.distributePowerBudget(heaters, budget, top, bot, powers);
+}
+
 void Heaters::zeroCrossed() {
+    HeatersMetrics::ZeroCrossScope zeroCross(_metrics);
+
+    _commitPendingSchedule();
+
     _heating();
 
     ++_currentFrame;
@@ -56,82 +245,281 @@ void Heaters::zeroCrossed() {
         _currentFrame = 0;
         _update();
     }
+
+    if(_mirror.isOpen()) _publishMirror();
 }
 
 void Heaters::_heating() {
-    // Для каждого нагревателя устанавливаем состояние выкл
-    for(auto& pairNumAndState: _heatersNumToState) {
-        pairNumAndState.second = false;
-    }
+    HeatersMetrics::Scope scope(_metrics.heating());
 
-    // В текущем фрейме находим Включенные нагреватели
-    for(HeaterNum heaterNum: _heatFrames[_currentFrame]) {
-        _heatersNumToState[heaterNum] = true;
-    }
+    _loadStates(_currentFrame);
+
+    for(HeaterNum word: _activeWords) {
+        HeatStateWord states = _states[word];
+
+        // Включения считаем только у включённых нагревателей
+        HeaterNum first = static_cast<HeaterNum>(word) * HEAT_STATE_WORD_BITS;
+
+        while(states) {
+            HeaterNum heaterNum = first + countTrailingZeros(states);
 
-    // В соответствии с мапой состояний вкл/выкл нагреватели
-    for(auto& pairNumAndState: _heatersNumToState) {
-        auto heaterNum = pairNumAndState.first;
-        auto state = pairNumAndState.second;
+            if(_heaters[heaterNum].countTurnOn()) _turnedOn.push_back(heaterNum);
 
-        _heaters[heaterNum].setState(state);
-        _setHeaterState(heaterNum, state);
+            states &= states - 1;
+        }
     }
-}
 
-bool Heaters::getLastSemiPeriodState(HeaterNum heaterNum) {
-    return _heaters[heaterNum].getLastState();
+    // Передаём состояния приёмнику одним вызовом
+    _metrics.countSinkCall();
+    _sink->setActiveStates(_states.data(), _changedStates.data(), _states.size(),
+                           _activeWords.data(), _activeWords.size());
 }
 
-std::vector<HeatFrame> Heaters::_getHeatFrames(const std::vector<Heater> &heaters) const {
-    std::vector<HeatFrame> heatFrames(FRAME_COUNT);
+void Heaters::_loadStates(Frame frame) {
+    const HeatFrameWord* frameWords = _schedule.getFrameWords(frame);
+    const HeaterNum stateWordsPerFrameWord = HEAT_FRAME_WORD_BITS / HEAT_STATE_WORD_BITS;
 
-    Frame frame = 0;
+    // Битовый набор кадра раскладываем по словам приёмника,
+    // изменившиеся состояния находим через XOR с прошлым полупериодом.
+    // В неактивных словах нет мощности, поэтому их состояния и изменения остаются нулевыми
+    for(std::size_t active = 0; active < _activeWords.size();) {
+        HeaterNum word = _activeWords[active];
+        HeatFrameWord frameWord = frameWords[word / stateWordsPerFrameWord];
+        HeatStateWord states = static_cast<HeatStateWord>(
+                frameWord >> (word % stateWordsPerFrameWord * HEAT_STATE_WORD_BITS));
 
-    for(HeaterNum heaterNum = 0; heaterNum < heaters.size(); ++heaterNum) {
-        for(Power power = 0; power < heaters[heaterNum].getCurrentPower(); ++power) {
-            heatFrames[frame].addHeater(heaterNum);
+        _changedStates[word] = _states[word] ^ states;
+        _states[word] = states;
 
-            ++frame;
-
-            if(frame >= FRAME_COUNT) frame = 0;
+        if(_poweredInWord[word] || states || _changedStates[word]) {
+            ++active;
+            continue;
         }
+
+        _isActiveWord[word] = false;
+        _activeWords[active] = _activeWords.back();
+        _activeWords.pop_back();
+
+        if(_mirror.isOpen()) _mirror.retireWord(word);
     }
+}
 
-    return heatFrames;
+void Heaters::advance(std::uint64_t seconds) {
+    advanceFrames(seconds * FRAME_COUNT);
 }
 
-std::pair<short, short> Heaters::_getMaximumEvenOddHeaters(const std::vector<HeatFrame>& heatFrames) {
-    short maxEvenHeaters = 0;
-    short maxOddHeaters = 0;
+void Heaters::advanceFrames(std::uint64_t frames) {
+    while(frames > 0) {
+        _commitPendingSchedule();
+
+        // Кусок до конца секунды: в нём схема нагревания не меняется
+        Frame from = _currentFrame;
+        Frame to = static_cast<Frame>(std::min<std::uint64_t>(FRAME_COUNT, from + frames));
+
+        // Нагреватели без мощности не включаются: обходим только активные слова
+        for(HeaterNum word: _activeWords) {
+            HeaterNum first = word * HEAT_STATE_WORD_BITS;
+            HeaterNum last = std::min<HeaterNum>(first + HEAT_STATE_WORD_BITS, _heaters.size());
 
-    for(const HeatFrame& frame: heatFrames) {
-        if (frame.getOddHeatersCount() > maxOddHeaters) {
-            maxOddHeaters = frame.getOddHeatersCount();
+            for(HeaterNum heaterNum = first; heaterNum < last; ++heaterNum) {
+                // За целую секунду нагреватель включён ровно на свою мощность
+                Power count = from == 0 && to == FRAME_COUNT ? _schedule.getPower(heaterNum)
+                                                             : _schedule.getHeatingFrames(heaterNum, from, to);
+
+                if(_heaters[heaterNum].countTurnOns(count)) _turnedOn.push_back(heaterNum);
+            }
         }
 
-        if (frame.getEvenHeatersCount() > maxEvenHeaters) {
-            maxEvenHeaters = frame.getEvenHeatersCount();
+        // Состояния и их изменение определяются двумя последними полупериодами куска
+        if(to - from > 1) _loadStates(to - 2);
+        _loadStates(to - 1);
+
+        frames -= to - from;
+        _currentFrame = to;
+
+        if(_secondLeft()) {
+            _currentFrame = 0;
+            _update();
         }
     }
 
-    return {maxEvenHeaters, maxOddHeaters};
+    if(_mirror.isOpen()) _publishMirror();
+}
+
+bool Heaters::getLastSemiPeriodState(HeaterNum heaterNum) {
+    // Состояние до последнего полупериода - текущее состояние с отменённым изменением
+    HeaterNum word = heaterNum / HEAT_STATE_WORD_BITS;
+    HeatStateWord lastStates = _states[word] ^ _changedStates[word];
+
+    return (lastStates >> (heaterNum % HEAT_STATE_WORD_BITS)) & 1u;
 }
 
 void Heaters::_update() {
-    for(Heater& heater: _heaters) {
-        heater.update();
+    HeatersMetrics::Scope scope(_metrics.update());
+
+    _history.roll();
+
+    // Нагреватели записываются в порядке включения; если включалась заметная часть
+    // нагревателей, обходим их по порядку номеров - так история пишется подряд
+    if(_turnedOn.size() * DENSE_SECOND_RATIO < _heaters.size()) {
+        for(HeaterNum heaterNum: _turnedOn) {
+            _history.record(heaterNum, _heaters[heaterNum].update());
+        }
+    } else {
+        for(HeaterNum heaterNum = 0; heaterNum < _heaters.size(); ++heaterNum) {
+            if(Power power = _heaters[heaterNum].update()) _history.record(heaterNum, power);
+        }
     }
+
+    _turnedOn.clear();
 }
 
 Power Heaters::getPower(HeaterNum heater, unsigned short timeOffset) {
     if(heater < _heaters.size()) {
-        return _heaters[heater].getPower(timeOffset);
+        return _history.getPower(heater, timeOffset);
     } else {
         return 0;
     }
 }
 
+std::uint32_t Heaters::getPowerSum(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) {
+    if(heater >= _heaters.size()) return 0;
+
+    return _history.getPowerSum(heater, fromOffset, toOffset);
+}
+
+Power Heaters::getAveragePower(HeaterNum heater, unsigned short seconds) {
+    if(heater >= _heaters.size()) return 0;
+
+    return _history.getAveragePower(heater, seconds);
+}
+
+Power Heaters::getMinPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) {
+    if(heater >= _heaters.size()) return 0;
+
+    return _history.getMinPower(heater, fromOffset, toOffset);
+}
+
+Power Heaters::getMaxPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) {
+    if(heater >= _heaters.size()) return 0;
+
+    return _history.getMaxPower(heater, fromOffset, toOffset);
+}
+
+PowerAggregate Heaters::getPowerAggregate(HeaterNum heater, std::uint32_t timeOffset) {
+    if(heater >= _heaters.size()) return PowerAggregate();
+
+    return _history.getPowerAggregate(heater, timeOffset);
+}
+
+Power Heaters::getLongTermPower(HeaterNum heater, std::uint32_t timeOffset) {
+    PowerAggregate aggregate = getPowerAggregate(heater, timeOffset);
+
+    if(aggregate.seconds == 0) return 0;
+
+    return (aggregate.sum + aggregate.seconds / 2) / aggregate.seconds;
+}
+
+std::pair<HeaterNum, HeaterNum> Heaters::getTurnedHeaters(Frame frame) const {
+    const HeatFrame& heatFrame = _schedule.getFrame(frame);
+
+    return std::make_pair(heatFrame.getEvenHeatersCount(), heatFrame.getOddHeatersCount());
+}
+
+Power Heaters::getScheduledPower(HeaterNum heater) const {
+    return heater < _heaters.size() ? _schedule.getPower(heater) : 0;
+}
+
+Frame Heaters::getCurrentFrame() const {
+    return _currentFrame;
+}
+
+Frame Heaters::getFrameCount() const {
+    return FRAME_COUNT;
+}
+
+HeatersMetricsSnapshot Heaters::getMetrics() const {
+    return _metrics.getSnapshot();
+}
+
+void Heaters::setDeadline(std::chrono::nanoseconds deadline) {
+    _metrics.setDeadline(deadline);
+}
+
 bool Heaters::_secondLeft() const {
     return _currentFrame == FRAME_COUNT;
 }
+
+void Heaters::_commitPendingSchedule() {
+    if(_builder) {
+        // Схема уже построена: забираем её заменой указателя и обменом буферов
+        if(_builder->acquire(_schedule, _currentFrame == 0, _builtChanges)) _adoptSchedule(_builtChanges);
+        return;
+    }
+
+    if(!_hasPendingSchedule) return;
+
+    if(_pendingCommit == PowersCommit::NEXT_SECOND && _currentFrame != 0) return;
+
+    std::swap(_schedule, _pendingSchedule);
+    _hasPendingSchedule = false;
+
+    _adoptSchedule(_pendingChanges);
+    _pendingChanges.clear();
+}
+
+void Heaters::_adoptSchedule(const std::vector<HeaterNum>& changed) {
+    HeatersMetrics::Scope scope(_metrics.scheduleUpdate());
+
+    // Мощности остальных нагревателей в схеме не менялись
+    for(HeaterNum heaterNum: changed) {
+        Power oldPower = _heaters[heaterNum].getCurrentPower();
+        Power power = _schedule.getPower(heaterNum);
+
+        _isPendingChange[heaterNum] = false;
+        _heaters[heaterNum].setPower(power);
+        _updatePowered(heaterNum, oldPower, power);
+        _history.storePower(heaterNum, power);
+
+        if(_mirror.isOpen()) _mirror.storePower(heaterNum, power);
+    }
+}
+
+void Heaters::_markPendingChange(HeaterNum heater) {
+    if(_isPendingChange[heater]) return;
+
+    _isPendingChange[heater] = true;
+    _pendingChanges.push_back(heater);
+}
+
+void Heaters::_publishMirror() {
+    _mirror.publishFrame(_states.data(), _changedStates.data(), _activeWords.data(), _activeWords.size(),
+                         _currentFrame, _history.getEpoch());
+}
+
+void Heaters::_updatePowered(HeaterNum heater, Power oldPower, Power newPower) {
+    if((oldPower > 0) == (newPower > 0)) return;
+
+    HeaterNum word = heater / HEAT_STATE_WORD_BITS;
+
+    if(newPower == 0) {
+        // Слово остаётся активным до передачи выключения приёмнику
+        --_poweredInWord[word];
+        return;
+    }
+
+    ++_poweredInWord[word];
+
+    if(!_isActiveWord[word]) {
+        _isActiveWord[word] = true;
+        _activeWords.push_back(word);
+    }
+}
+
+void Heaters::_countPowered() {
+    std::fill(_poweredInWord.begin(), _poweredInWord.end(), 0);
+
+    for(HeaterNum heaterNum = 0; heaterNum < _heaters.size(); ++heaterNum) {
+        _updatePowered(heaterNum, 0, _heaters[heaterNum].getCurrentPower());
+    }
+}
@@ -1,27 +1,22 @@
 #ifndef HEATERS
 #define HEATERS
 
-#include <stack>
-#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include "variables_description.h"
 #include "heater.h"
-#include "heater_frame.h"
+#include "iheaters.h"
+#include "heat_sink.h"
+#include "heat_schedule.h"
+#include "heaters_metrics.h"
+#include "power_history.h"
+#include "state_mirror.h"
 
-class IHeaters {
-public:
-    virtual ~IHeaters() = default;
-
-    virtual void setPower(HeaterNum, Power) = 0;
-
-    virtual void getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum, Power,
-                                                          unsigned int&, unsigned int&) = 0;
-
-    virtual Power getPower(HeaterNum, unsigned short timeOffset = 0) = 0;
-
-    virtual bool getLastSemiPeriodState(HeaterNum) = 0;
-};
+class ScheduleBuilder;
 
 class Heaters : public IHeaters {
 public:
@@ -30,10 +25,53 @@ public:
      *
      * @param setHeaterStateFn - функция для установки состояния
      * 		  нагревателя с указанным номером от нуля (true - включить,
-     * 		  false - выключить)
+     * 		  false - выключить), вызывается каждый полупериод для каждого нагревателя
+     *
+     * @param layout - способ раскладки нагревателей по полупериодам
+     * 		  (BALANCED минимизирует пики верхних и нижних нагревателей)
      */
     Heaters(HeaterNum heatersNum,
-            HeatSetter setHeaterStateFn);
+            HeatSetter setHeaterStateFn,
+            ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param sink - приёмник упакованных состояний нагревателей
+     * 		  (должен существовать всё время работы модуля)
+     *
+     * @param layout - способ раскладки нагревателей по полупериодам
+     */
+    Heaters(HeaterNum heatersNum,
+            IHeatSink& sink,
+            ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    ~Heaters() override;
+
+    /**
+     * Переносит историю мощностей и текущие мощности в отображённый в память файл
+     *
+     * @note Вызывается сразу после создания модуля. Если файл содержит состояние
+     *       прошлого запуска (RESTORED), история и мощности нагревателей восстанавливаются
+     *       из него, иначе файл заполняется текущим состоянием
+     *
+     * @param path - путь к файлу истории
+     */
+    HistoryFile attachHistoryFile(const std::string& path);
+
+    /**
+     * Начинает публиковать мощности, состояния прошлого полупериода, номер полупериода
+     * и голову истории в разделяемую память POSIX для внешних процессов мониторинга
+     * (см. StateMirror, StateMirrorReader)
+     *
+     * @note Состояния публикуются в каждом zeroCrossed() одной записью под seqlock,
+     *       мощности - при их изменении. Поток перехода через ноль никогда не ждёт читателей
+     *
+     * @param name - имя сегмента разделяемой памяти вида "/name"
+     *
+     * @return false, если сегмент не удалось создать
+     */
+    bool attachStateMirror(const std::string& name);
 
     /**
      * Устанавливает заданную мощность на нагреватель
@@ -44,6 +82,49 @@ public:
      */
     void setPower(HeaterNum heater, Power power) override;
 
+    /**
+     * Устанавливает мощности на несколько нагревателей одной транзакцией
+     *
+     * @note Набор проверяется целиком: если хотя бы один нагреватель или мощность
+     *       некорректны, ни одна мощность не устанавливается.
+     *       Схема нагревания перестраивается один раз и вступает в силу целиком
+     *       на границе кадра, выбранной commit, т.е. zeroCrossed никогда
+     *       не видит частично применённый набор.
+     *
+     * @param powers - пары (нагреватель, мощность в процентах от нуля до 100)
+     *
+     * @param commit - момент, с которого вступают в силу новые мощности
+     *
+     * @return true, если набор принят
+     */
+    bool setPowers(const HeaterPowers& powers, PowersCommit commit = PowersCommit::NEXT_FRAME) override;
+
+    /**
+     * Переводит модуль в режим фонового построения схемы нагревания (см. ScheduleBuilder)
+     *
+     * @note В этом режиме setPower() и setPowers() только передают мощности потоку построения
+     *       и могут вызываться из любого потока. Построенная схема вступает в силу
+     *       в ближайшем zeroCrossed() (policy NEXT_FRAME) или в начале секунды (NEXT_SECOND);
+     *       запросы, пришедшие во время построения, объединяются в одну схему.
+     *       Отложенная схема setPowers() передаётся потоку построения.
+     *       Запросы пиков, групп и истории по-прежнему вызываются из потока перехода через ноль.
+     *
+     * @param policy - момент вступления в силу схем, построенных по setPower()
+     */
+    void startScheduleBuilder(PowersCommit policy = PowersCommit::NEXT_FRAME);
+
+    /**
+     * Достраивает запрошенные мощности и возвращает модуль в синхронный режим
+     *
+     * @note Не вступившая в силу схема становится отложенной схемой setPowers()
+     */
+    void stopScheduleBuilder();
+
+    /**
+     * Ждёт, пока поток построения опубликует схему со всеми запрошенными мощностями
+     */
+    void waitScheduleBuilder();
+
     /**
      * Вычисляет максимальную суммарную мощность,
      * которая будет выделяться на нагревателях в любой момент времени,
@@ -64,6 +145,77 @@ public:
             HeaterNum heater, Power power,
             unsigned int& top, unsigned int& bot) override;
 
+    /**
+     * Вычисляет getMaxNumOfTurnedHeatersAfterPowerChange() для набора кандидатов
+     * по одной общей схеме (см. HeatSchedule::getMaximumEvenOddHeatersAfterPowerChanges)
+     *
+     * @note Кандидат с некорректным нагревателем или мощностью больше 100
+     *       получает пики текущей схемы
+     *
+     * @param[in] candidates - пары (нагреватель, мощность)
+     *
+     * @param[out] peaks - пары (top, bot) для кандидатов в их порядке
+     */
+    void getMaxNumOfTurnedHeatersAfterPowerChanges(const HeaterPowers& candidates,
+                                                   std::vector<std::pair<HeaterNum, HeaterNum>>& peaks);
+
+    /**
+     * Задаёт группы нагрузки (например, фаза сети и фидер), пики которых можно запрашивать
+     * через getMaxNumOfTurnedHeatersInGroups
+     *
+     * @param groupsCount - количество групп
+     *
+     * @param memberships - номера групп каждого нагревателя
+     *
+     * @return false, если номер группы или нагревателя некорректен
+     *         или включено фоновое построение схемы
+     */
+    bool setLoadGroups(GroupNum groupsCount, const GroupMemberships& memberships);
+
+    /**
+     * Вычисляет максимальное количество одновременно работающих нагревателей каждой группы
+     *
+     * @param[out] peaks - пики групп по их номерам
+     */
+    void getMaxNumOfTurnedHeatersInGroups(std::vector<HeaterNum>& peaks);
+
+    /**
+     * Вычисляет пики групп, которые получатся, если установить нагревателю заданную мощность
+     *
+     * @note Некорректные нагреватель или мощность дают пики текущей схемы
+     *
+     * @param[out] peaks - пики групп по их номерам
+     */
+    void getMaxNumOfTurnedHeatersInGroupsAfterPowerChange(HeaterNum heater, Power power,
+                                                          std::vector<HeaterNum>& peaks);
+
+    /**
+     * Находит наибольшую мощность нагревателя, при которой одновременно работает
+     * не больше top верхних и bot нижних нагревателей
+     *
+     * @note Вычисляется по счётчикам кадров без пробных перестроений схемы,
+     *       см. HeatSchedule::getMaximumAdmissiblePower
+     *
+     * @param[out] power - наибольшая допустимая мощность в процентах
+     *
+     * @return false, если пределы превышены при любой мощности нагревателя
+     */
+    bool getMaxAdmissiblePower(HeaterNum heater, unsigned int top, unsigned int bot, Power& power);
+
+    /**
+     * Распределяет суммарную мощность budget между нагревателями так,
+     * чтобы одновременно работало не больше top верхних и bot нижних нагревателей
+     *
+     * @note Мощности не устанавливаются - их можно применить через setPowers().
+     *       Оценка идёт на рабочей копии схемы, см. HeatSchedule::distributePowerBudget
+     *
+     * @param[out] powers - пары (нагреватель, мощность) для корректных нагревателей набора
+     *
+     * @return распределённая мощность
+     */
+    std::uint32_t distributePowerBudget(const std::vector<HeaterNum>& heaters, std::uint32_t budget,
+                                        unsigned int top, unsigned int bot, HeaterPowers& powers);
+
     /**
      * Возвращает текущую мощность нагревателя или мощность,
      * установленную в прошлом
@@ -80,6 +232,50 @@ public:
      */
     Power getPower(HeaterNum heater, unsigned short timeOffset = 0) override;
 
+    /**
+     * Возвращает сумму мощностей нагревателя (энергию в процент-секундах)
+     * за секунды [fromOffset, toOffset] истории
+     *
+     * @note Смещения задаются как в getPower(), секунды за пределами истории нулевые.
+     *       Вычисляется за O(1) по накопленным суммам
+     */
+    std::uint32_t getPowerSum(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset);
+
+    /**
+     * Возвращает округлённую среднюю мощность нагревателя за последние seconds завершённых секунд
+     */
+    Power getAveragePower(HeaterNum heater, unsigned short seconds);
+
+    /**
+     * Возвращает минимальную мощность нагревателя за секунды [fromOffset, toOffset] истории
+     *
+     * @note Вычисляется за O(8 + log 75)
+     */
+    Power getMinPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset);
+
+    /**
+     * Возвращает максимальную мощность нагревателя за секунды [fromOffset, toOffset] истории
+     *
+     * @note Вычисляется за O(8 + log 75)
+     */
+    Power getMaxPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset);
+
+    /**
+     * Возвращает сводку мощностей нагревателя за интервал, содержащий секунду timeOffset назад
+     *
+     * @note Старше 600 секунд история хранится поминутно (60 минут), затем почасово (24 часа),
+     *       см. PowerHistory::getPowerAggregate
+     */
+    PowerAggregate getPowerAggregate(HeaterNum heater, std::uint32_t timeOffset);
+
+    /**
+     * Возвращает среднюю мощность нагревателя в интервале, содержащем секунду timeOffset назад,
+     * на уровне истории, соответствующем смещению
+     *
+     * @return 0, если смещение выходит за пределы истории
+     */
+    Power getLongTermPower(HeaterNum heater, std::uint32_t timeOffset);
+
     /**
      * Возвращает состояние нагревателя в прошлый полупериод
      *
@@ -95,30 +291,72 @@ public:
      */
     void zeroCrossed();
 
-private:
     /**
-     * Возвращает максимальное количество включенных нижних и верхних нагревателей
-     * @param heatFrames - вектор кадров нагревания
-     * @return first - четные, second - нечётные
+     * Выполняет seconds секунд так же, как 100 * seconds вызовов zeroCrossed()
+     *
+     * @see advanceFrames
      */
-    static std::pair<short, short> _getMaximumEvenOddHeaters(const std::vector<HeatFrame>& heatFrames);
+    void advance(std::uint64_t seconds);
+
+    /**
+     * Выполняет frames полупериодов так же, как frames вызовов zeroCrossed(),
+     * но без вызовов приёмника состояний (режим моделирования).
+     *
+     * История мощностей, состояния нагревателей (getLastSemiPeriodState) и номер
+     * полупериода совпадают с результатом покадрового выполнения. Включения считаются
+     * по отрезкам схемы нагревания сразу за кусок секунды, т.е. за O(количества нагревателей)
+     * на секунду вместо O(100 * количества нагревателей) с вызовами приёмника.
+     */
+    void advanceFrames(std::uint64_t frames);
 
-private:
     /**
-     * Выполняет обновление схемы нагревания
-     * в соответствии с установленными мощностями
+     * Возвращает количество включённых верхних (first) и нижних (second) нагревателей
+     * в полупериоде frame текущей схемы
      */
-    void _updateHeatFrames();
+    std::pair<HeaterNum, HeaterNum> getTurnedHeaters(Frame frame) const;
 
     /**
-     * Возвращает контейнер кадров нагревания
-     * @param heaters - контейнер нагревателей
-     * @return вектор кадров нагревании
+     * Возвращает мощность нагревателя, по которой построена действующая схема нагревания
+     * (отложенные наборы setPowers() ещё не учтены)
      */
-    std::vector<HeatFrame> _getHeatFrames(const std::vector<Heater>& heaters) const;
+    Power getScheduledPower(HeaterNum heater) const;
+
+    /**
+     * Возвращает номер полупериода внутри секунды, который выполнит следующий zeroCrossed()
+     */
+    Frame getCurrentFrame() const;
+
+    /**
+     * Количество полупериодов в секунде
+     */
+    Frame getFrameCount() const;
+
+    /**
+     * Возвращает снимок встроенных замеров (см. HeatersMetrics)
+     *
+     * @note Можно вызывать из любого потока
+     */
+    HeatersMetricsSnapshot getMetrics() const;
+
+    /**
+     * Устанавливает срок выполнения zeroCrossed(), превышение которого считается пропуском
+     */
+    void setDeadline(std::chrono::nanoseconds deadline);
+
+private:
+    /**
+     * @param sink - внешний приёмник состояний или nullptr, если используется ownedSink
+     *
+     * @param ownedSink - приёмник, которым владеет модуль
+     */
+    Heaters(HeaterNum heatersNum, IHeatSink* sink, std::unique_ptr<IHeatSink> ownedSink,
+            ScheduleLayout layout);
 
      /**
-     * Метод обновляет состояние всех нагревателей
+     * Метод завершает секунду нагревателей, включавшихся за неё
+     *
+     * @note Нагреватели, не включавшиеся за секунду, не обходятся:
+     *       их история дополняется нулями лениво (см. PowerHistory::record)
      */
     void _update();
 
@@ -127,23 +365,132 @@ private:
      * Вызывается каждый полупериод.
      */
     void _heating();
+
+    /**
+     * Загружает упакованные состояния кадра frame и их изменения относительно прошлого полупериода
+     *
+     * @note Обходит только активные слова; слово, в котором не осталось мощности,
+     *       включённых и изменившихся нагревателей, исключается из активных
+     */
+    void _loadStates(Frame frame);
     /**
      * Данный метод проверяет сколько времени работал модуль
      * @return Возвращает true, если прошла 1 секунда, иначе false
      */
     bool _secondLeft() const;
 
+    /**
+     * Применяет отложенную схему нагревания, если наступил момент её вступления в силу
+     */
+    void _commitPendingSchedule();
+
+    /**
+     * Переносит мощности новой текущей схемы в нагреватели и историю
+     *
+     * @param changed - нагреватели, мощность которых в схеме могла измениться
+     */
+    void _adoptSchedule(const std::vector<HeaterNum>& changed);
+
+    /**
+     * Отмечает нагреватель, мощность которого в отложенной схеме могла измениться
+     */
+    void _markPendingChange(HeaterNum heater);
+
+    /**
+     * Публикует состояния полупериода, номер полупериода и голову истории в зеркало состояния
+     */
+    void _publishMirror();
+
+    /**
+     * Учитывает смену мощности нагревателя с нулевой на ненулевую и обратно
+     */
+    void _updatePowered(HeaterNum heater, Power oldPower, Power newPower);
+
+    /**
+     * Пересчитывает нагреватели с ненулевой мощностью по текущей схеме
+     */
+    void _countPowered();
+
 private:
     /**
      * Количество полупериодов в 1 секунде
      */
     const short FRAME_COUNT = 100;
 
+    /**
+     * Количество кандидатов пакетного запроса, обрабатываемое без выделения памяти
+     */
+    static const std::size_t CANDIDATES_CAPACITY = 1024;
+
+    /**
+     * Если за секунду включалось больше 1/DENSE_SECOND_RATIO нагревателей,
+     * история обновляется обходом всех нагревателей по порядку
+     */
+    static const std::size_t DENSE_SECOND_RATIO = 8;
+
 private:
     std::vector<Heater> _heaters;
-    HeatSetter _setHeaterState;
-    std::vector<HeatFrame> _heatFrames;
-    std::unordered_map<HeaterNum, bool> _heatersNumToState;
+    /**
+     * Адаптер функции установки состояния, если модуль создан с HeatSetter
+     */
+    std::unique_ptr<IHeatSink> _ownedSink;
+    IHeatSink* _sink;
+    PowerHistory _history;
+    /**
+     * Зеркало состояния для внешних процессов (не открыто, если не подключено)
+     */
+    StateMirror _mirror;
+    HeatSchedule _schedule;
+    /**
+     * Схема, построенная setPowers и ожидающая вступления в силу
+     */
+    HeatSchedule _pendingSchedule;
+    bool _hasPendingSchedule = false;
+    PowersCommit _pendingCommit = PowersCommit::NEXT_FRAME;
+    /**
+     * Нагреватели, мощность которых в отложенной схеме может отличаться от текущей,
+     * и изменения схемы, забранной у потока построения (память выделена в конструкторе)
+     */
+    std::vector<HeaterNum> _pendingChanges;
+    std::vector<unsigned char> _isPendingChange;
+    std::vector<HeaterNum> _builtChanges;
+    /**
+     * Поток построения схемы или nullptr в синхронном режиме
+     */
+    std::unique_ptr<ScheduleBuilder> _builder;
+    /**
+     * Рабочие копия схемы и порядок кандидатов для запросов
+     * (память выделена в конструкторе)
+     */
+    HeatSchedule _scratchSchedule;
+    std::vector<std::size_t> _candidatesOrder;
+    /**
+     * Рабочий массив изменений счётчиков групп (память выделяется в setLoadGroups)
+     */
+    std::vector<int> _groupsDiff;
+    HeatersMetrics _metrics;
+    /**
+     * Упакованные состояния нагревателей в текущем полупериоде
+     */
+    std::vector<HeatStateWord> _states;
+    /**
+     * Маска нагревателей, состояние которых изменилось в текущем полупериоде
+     */
+    std::vector<HeatStateWord> _changedStates;
+    /**
+     * Нагреватели, включавшиеся в текущей секунде (память выделена в конструкторе)
+     */
+    std::vector<HeaterNum> _turnedOn;
+    /**
+     * Количество нагревателей с ненулевой мощностью в каждом слове состояний
+     */
+    std::vector<unsigned char> _poweredInWord;
+    /**
+     * Активные слова состояний: с нагревателями с ненулевой мощностью
+     * или с ещё не переданным приёмнику выключением (память выделена в конструкторе)
+     */
+    std::vector<HeaterNum> _activeWords;
+    std::vector<unsigned char> _isActiveWord;
     Frame _currentFrame = 0;
 };
 #endif // HEATERS
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "heaters_metrics.h"
+
+#include <algorithm>
+
+#include "bit_operations.h"
+
+constexpr std::chrono::nanoseconds HeatersMetrics::DEFAULT_DEADLINE;
+
+std::uint64_t LatencySnapshot::getPercentileBound(double fraction) const {
+    if(count == 0) return 0;
+
+    // Количество замеров, которое должно оказаться не выше искомой границы
+    auto target = static_cast<std::uint64_t>(fraction * static_cast<double>(count));
+    std::uint64_t seen = 0;
+
+    for(std::size_t bucket = 0; bucket + 1 < BUCKETS_COUNT; ++bucket) {
+        seen += buckets[bucket];
+
+        if(seen >= target && seen > 0) return bucket == 0 ? 0 : (std::uint64_t(1) << bucket) - 1;
+    }
+
+    return maxNanoseconds;
+}
+
+std::size_t LatencyHistogram::getBucket(std::uint64_t nanoseconds) {
+    if(nanoseconds == 0) return 0;
+
+    // Номер старшего бита + 1
+    std::size_t bucket = 64 - countLeadingZeros(nanoseconds);
+
+    return std::min(bucket, LatencySnapshot::BUCKETS_COUNT - 1);
+}
+
+void LatencyHistogram::record(std::uint64_t nanoseconds) {
+    HeatersMetrics::increment(_buckets[getBucket(nanoseconds)]);
+    HeatersMetrics::increment(_count);
+
+    _totalNanoseconds.store(_totalNanoseconds.load(std::memory_order_relaxed) + nanoseconds,
+                            std::memory_order_relaxed);
+
+    if(nanoseconds > _maxNanoseconds.load(std::memory_order_relaxed)) {
+        _maxNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+LatencySnapshot LatencyHistogram::getSnapshot() const {
+    LatencySnapshot snapshot;
+
+    for(std::size_t bucket = 0; bucket < snapshot.buckets.size(); ++bucket) {
+        snapshot.buckets[bucket] = _buckets[bucket].load(std::memory_order_relaxed);
+    }
+
+    snapshot.count = _count.load(std::memory_order_relaxed);
+    snapshot.totalNanoseconds = _totalNanoseconds.load(std::memory_order_relaxed);
+    snapshot.maxNanoseconds = _maxNanoseconds.load(std::memory_order_relaxed);
+
+    return snapshot;
+}
+
+void HeatersMetrics::setDeadline(std::chrono::nanoseconds deadline) {
+    _deadlineNanoseconds.store(static_cast<std::uint64_t>(deadline.count()), std::memory_order_relaxed);
+}
+
+HeatersMetricsSnapshot HeatersMetrics::getSnapshot() const {
+    HeatersMetricsSnapshot snapshot;
+
+    snapshot.zeroCrossed = _zeroCrossed.getSnapshot();
+    snapshot.heating = _heating.getSnapshot();
+    snapshot.update = _update.getSnapshot();
+    snapshot.scheduleUpdate = _scheduleUpdate.getSnapshot();
+    snapshot.sinkCalls = _sinkCalls.load(std::memory_order_relaxed);
+    snapshot.deadlineMisses = _deadlineMisses.load(std::memory_order_relaxed);
+    snapshot.deadline = std::chrono::nanoseconds(_deadlineNanoseconds.load(std::memory_order_relaxed));
+
+    return snapshot;
+}
@@ -0,0 +1,197 @@
+#ifndef HEATERS_HEATERS_METRICS_H
+#define HEATERS_HEATERS_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Встроенные замеры горячих путей модуля Heaters.
+ *
+ * Включаются при сборке с HEATERS_INSTRUMENTATION=1 (опция CMake HEATERS_INSTRUMENTATION, по умолчанию выключена).
+ * Без неё замеры не выполняются, а снимки остаются нулевыми.
+ *
+ * Все значения пишет только поток перехода через ноль (и вызовы setPower/setPowers
+ * из того же потока), поэтому запись - это атомарные load/store без блокировок
+ * и без инструкций с префиксом lock. Снимок можно читать из любого потока.
+ */
+
+#ifndef HEATERS_INSTRUMENTATION
+#define HEATERS_INSTRUMENTATION 0
+#endif
+
+/**
+ * Снимок гистограммы длительностей
+ */
+struct LatencySnapshot {
+    /**
+     * Количество корзин: корзина 0 - длительность 0 нс,
+     * корзина i - длительности [2^(i-1), 2^i) нс, последняя - всё, что длиннее
+     */
+    static const std::size_t BUCKETS_COUNT = 40;
+
+    std::array<std::uint64_t, BUCKETS_COUNT> buckets = {};
+    std::uint64_t count = 0;
+    std::uint64_t totalNanoseconds = 0;
+    std::uint64_t maxNanoseconds = 0;
+
+    /**
+     * Возвращает верхнюю границу корзины, в которую попадает доля fraction замеров
+     * (например, 0.99 - 99-й перцентиль с точностью до степени двойки)
+     */
+    std::uint64_t getPercentileBound(double fraction) const;
+};
+
+/**
+ * Гистограмма длительностей с логарифмическими корзинами
+ */
+class LatencyHistogram {
+public:
+    void record(std::uint64_t nanoseconds);
+
+    LatencySnapshot getSnapshot() const;
+
+    static std::size_t getBucket(std::uint64_t nanoseconds);
+
+private:
+    std::array<std::atomic<std::uint64_t>, LatencySnapshot::BUCKETS_COUNT> _buckets = {};
+    std::atomic<std::uint64_t> _count{0};
+    std::atomic<std::uint64_t> _totalNanoseconds{0};
+    std::atomic<std::uint64_t> _maxNanoseconds{0};
+};
+
+/**
+ * Снимок замеров модуля
+ */
+struct HeatersMetricsSnapshot {
+    /**
+     * Полупериод целиком (zeroCrossed)
+     */
+    LatencySnapshot zeroCrossed;
+    /**
+     * Включение/выключение нагревателей и вызов приёмника (_heating)
+     */
+    LatencySnapshot heating;
+    /**
+     * Ежесекундное обновление истории (_update)
+     */
+    LatencySnapshot update;
+    /**
+     * Изменения схемы нагревания: setPower, setPowers и вступление в силу отложенной схемы
+     */
+    LatencySnapshot scheduleUpdate;
+
+    /**
+     * Количество вызовов приёмника состояний
+     */
+    std::uint64_t sinkCalls = 0;
+    /**
+     * Количество полупериодов, выполнявшихся дольше заданного срока
+     */
+    std::uint64_t deadlineMisses = 0;
+    std::chrono::nanoseconds deadline{0};
+};
+
+/**
+ * Замеры модуля Heaters
+ */
+class HeatersMetrics {
+public:
+    /**
+     * Срок выполнения полупериода по умолчанию - сам полупериод при 50 Гц
+     */
+    static constexpr std::chrono::nanoseconds DEFAULT_DEADLINE = std::chrono::milliseconds(10);
+
+    /**
+     * Замер длительности области видимости
+     */
+    class Scope {
+    public:
+        explicit Scope(LatencyHistogram& histogram)
+#if HEATERS_INSTRUMENTATION
+                : _histogram(histogram), _start(std::chrono::steady_clock::now())
+#endif
+        {
+            static_cast<void>(histogram);
+        }
+
+        ~Scope() {
+#if HEATERS_INSTRUMENTATION
+            _histogram.record(getNanoseconds());
+#endif
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+#if HEATERS_INSTRUMENTATION
+        std::uint64_t getNanoseconds() const {
+            auto elapsed = std::chrono::steady_clock::now() - _start;
+
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        }
+
+    private:
+        LatencyHistogram& _histogram;
+        std::chrono::steady_clock::time_point _start;
+#endif
+    };
+
+    /**
+     * Полупериод: кроме гистограммы учитывает пропуск срока
+     */
+    class ZeroCrossScope {
+    public:
+        explicit ZeroCrossScope(HeatersMetrics& metrics)
+                : _metrics(metrics), _scope(metrics._zeroCrossed) {
+        }
+
+        ~ZeroCrossScope() {
+#if HEATERS_INSTRUMENTATION
+            if(_scope.getNanoseconds() > _metrics._deadlineNanoseconds.load(std::memory_order_relaxed)) {
+                increment(_metrics._deadlineMisses);
+            }
+#endif
+            static_cast<void>(_metrics);
+        }
+
+    private:
+        HeatersMetrics& _metrics;
+        Scope _scope;
+    };
+
+    void setDeadline(std::chrono::nanoseconds deadline);
+
+    void countSinkCall() {
+#if HEATERS_INSTRUMENTATION
+        increment(_sinkCalls);
+#endif
+    }
+
+    LatencyHistogram& heating() { return _heating; }
+    LatencyHistogram& update() { return _update; }
+    LatencyHistogram& scheduleUpdate() { return _scheduleUpdate; }
+
+    HeatersMetricsSnapshot getSnapshot() const;
+
+    /**
+     * Увеличивает счётчик единственного писателя без lock-инструкции
+     */
+    static void increment(std::atomic<std::uint64_t>& counter) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+private:
+    LatencyHistogram _zeroCrossed;
+    LatencyHistogram _heating;
+    LatencyHistogram _update;
+    LatencyHistogram _scheduleUpdate;
+    std::atomic<std::uint64_t> _sinkCalls{0};
+    std::atomic<std::uint64_t> _deadlineMisses{0};
+    std::atomic<std::uint64_t> _deadlineNanoseconds{
+            static_cast<std::uint64_t>(DEFAULT_DEADLINE.count())};
+};
+
+#endif //HEATERS_HEATERS_METRICS_H
@@ -0,0 +1,36 @@
+#ifndef HEATERS_IHEATERS_H
+#define HEATERS_IHEATERS_H
+
+#include "variables_description.h"
+
+/**
+ * Момент, с которого вступают в силу мощности, установленные через setPowers
+ */
+enum class PowersCommit {
+    /**
+     * Со следующего полупериода
+     */
+    NEXT_FRAME,
+    /**
+     * С начала следующей секунды
+     */
+    NEXT_SECOND
+};
+
+class IHeaters {
+public:
+    virtual ~IHeaters() = default;
+
+    virtual void setPower(HeaterNum, Power) = 0;
+
+    virtual bool setPowers(const HeaterPowers&, PowersCommit commit = PowersCommit::NEXT_FRAME) = 0;
+
+    virtual void getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum, Power,
+                                                          unsigned int&, unsigned int&) = 0;
+
+    virtual Power getPower(HeaterNum, unsigned short timeOffset = 0) = 0;
+
+    virtual bool getLastSemiPeriodState(HeaterNum) = 0;
+};
+
+#endif //HEATERS_IHEATERS_H
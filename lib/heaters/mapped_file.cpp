@@ -0,0 +1,110 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <utility>
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+        : _data(other._data), _size(other._size) {
+    other._data = nullptr;
+    other._size = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if(this != &other) {
+        close();
+        std::swap(_data, other._data);
+        std::swap(_size, other._size);
+    }
+
+    return *this;
+}
+
+bool MappedFile::open(const std::string& path, std::size_t size) {
+    close();
+
+    if(size == 0) return false;
+
+    int file = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+
+    if(file < 0) return false;
+
+    return _map(file, size);
+}
+
+bool MappedFile::createShared(const std::string& name, std::size_t size) {
+    close();
+
+    if(size == 0) return false;
+
+    unlinkShared(name);
+
+    int file = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if(file < 0) return false;
+
+    return _map(file, size);
+}
+
+bool MappedFile::openSharedReadOnly(const std::string& name) {
+    close();
+
+    int file = ::shm_open(name.c_str(), O_RDONLY, 0);
+
+    if(file < 0) return false;
+
+    return _map(file, 0);
+}
+
+void MappedFile::unlinkShared(const std::string& name) {
+    ::shm_unlink(name.c_str());
+}
+
+bool MappedFile::_map(int file, std::size_t size) {
+    bool readOnly = size == 0;
+    struct stat status;
+    bool sized = ::fstat(file, &status) == 0;
+
+    if(sized && readOnly) {
+        size = static_cast<std::size_t>(status.st_size);
+        sized = size != 0;
+    } else if(sized && static_cast<std::size_t>(status.st_size) != size) {
+        sized = ::ftruncate(file, static_cast<off_t>(size)) == 0;
+    }
+
+    void* data = sized ? ::mmap(nullptr, size, readOnly ? PROT_READ : PROT_READ | PROT_WRITE, MAP_SHARED, file, 0)
+                       : MAP_FAILED;
+
+    // Отображение остаётся действительным и после закрытия дескриптора
+    ::close(file);
+
+    if(data == MAP_FAILED) return false;
+
+    _data = static_cast<unsigned char*>(data);
+    _size = size;
+
+    return true;
+}
+
+void MappedFile::close() {
+    if(!_data) return;
+
+    ::munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+}
+
+unsigned char* MappedFile::getData() const {
+    return _data;
+}
+
+std::size_t MappedFile::getSize() const {
+    return _size;
+}
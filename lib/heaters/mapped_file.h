@@ -0,0 +1,82 @@
+#ifndef HEATERS_MAPPED_FILE_H
+#define HEATERS_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * Файл, целиком отображённый в память (POSIX mmap).
+ *
+ * Изменения попадают в страничный кэш и переживают перезапуск процесса
+ * без явной записи; ядро сбрасывает их на диск само.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * Открывает (или создаёт) файл, устанавливает его размер и отображает в память
+     *
+     * @note Новые байты файла нулевые
+     *
+     * @return false, если файл не удалось открыть или отобразить
+     */
+    bool open(const std::string& path, std::size_t size);
+
+    /**
+     * Создаёт разделяемую память POSIX (shm_open) с именем name и отображает её
+     *
+     * @note Прежний объект с тем же именем удаляется: процессы, отобразившие его,
+     *       продолжают работать со старым объектом
+     *
+     * @param name - имя объекта вида "/name"
+     *
+     * @return false, если объект не удалось создать или отобразить
+     */
+    bool createShared(const std::string& name, std::size_t size);
+
+    /**
+     * Отображает существующую разделяемую память POSIX только для чтения
+     *
+     * @note Размер отображения - размер объекта
+     *
+     * @return false, если объект не удалось открыть или отобразить
+     */
+    bool openSharedReadOnly(const std::string& name);
+
+    /**
+     * Удаляет имя разделяемой памяти POSIX (отображения остаются действительными)
+     */
+    static void unlinkShared(const std::string& name);
+
+    /**
+     * Снимает отображение
+     */
+    void close();
+
+    unsigned char* getData() const;
+
+    std::size_t getSize() const;
+
+private:
+    /**
+     * Устанавливает размер открытого файла (size != 0) и отображает его, закрывая дескриптор
+     *
+     * @param size - размер отображения или 0 для отображения файла целиком только для чтения
+     */
+    bool _map(int file, std::size_t size);
+
+private:
+    unsigned char* _data = nullptr;
+    std::size_t _size = 0;
+};
+
+#endif //HEATERS_MAPPED_FILE_H
@@ -0,0 +1,467 @@
+#include "power_history.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace {
+    const auto minSelect = [](unsigned char left, unsigned char right) { return std::min(left, right); };
+    const auto maxSelect = [](unsigned char left, unsigned char right) { return std::max(left, right); };
+
+    /**
+     * Выравнивание массивов блока истории
+     */
+    const std::size_t BLOCK_ALIGNMENT = 8;
+
+    /**
+     * Отводит в блоке место под count элементов и возвращает их начало
+     * (nullptr, если блок только измеряется)
+     */
+    template<typename T>
+    T* place(unsigned char* memory, std::size_t& offset, std::size_t count) {
+        offset = (offset + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+
+        T* result = memory ? reinterpret_cast<T*>(memory + offset) : nullptr;
+
+        offset += count * sizeof(T);
+
+        return result;
+    }
+}
+
+PowerHistory::PowerHistory(HeaterNum heatersNum)
+        : _heatersNum(heatersNum), _size(_bind(nullptr)),
+          _heap((_size + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t), 0) {
+    _bind(reinterpret_cast<unsigned char*>(_heap.data()));
+
+    // Нулевой блок - пустая история, остаётся заполнить заголовок
+    _state->magic = MAGIC;
+    _state->version = VERSION;
+    _state->heatersNum = heatersNum;
+    _state->size = _size;
+}
+
+HistoryFile PowerHistory::attachFile(const std::string& path) {
+    MappedFile file;
+
+    if(!file.open(path, _size)) return HistoryFile::FAILED;
+
+    bool restored = _isCompatible(file.getData());
+
+    if(!restored) {
+        std::memcpy(file.getData(), _state, _size);
+    }
+
+    _file = std::move(file);
+    _bind(_file.getData());
+
+    _heap.clear();
+    _heap.shrink_to_fit();
+
+    return restored ? HistoryFile::RESTORED : HistoryFile::CREATED;
+}
+
+void PowerHistory::storePower(HeaterNum heater, Power power) {
+    _powers[heater] = static_cast<Sample>(power);
+}
+
+Power PowerHistory::getStoredPower(HeaterNum heater) const {
+    return _powers[heater];
+}
+
+void PowerHistory::roll() {
+    ++_state->epoch;
+
+    // Прошлая секунда завершила минуту (час) - начинаем новую
+    if(_state->closingMinute) {
+        _state->secondsInMinute = 0;
+
+        if(_state->closingHour) _state->minutesInHour = 0;
+    }
+
+    _state->closingMinute = false;
+    _state->closingHour = false;
+
+    if(++_state->secondsInMinute < SECONDS_PER_MINUTE) return;
+
+    _state->closingMinute = true;
+
+    if(++_state->minuteHead >= MINUTES_LIMIT) _state->minuteHead = 0;
+    if(_state->minutesStored < MINUTES_LIMIT) ++_state->minutesStored;
+
+    if(++_state->minutesInHour < MINUTES_PER_HOUR) return;
+
+    _state->closingHour = true;
+
+    if(++_state->hourHead >= HOURS_LIMIT) _state->hourHead = 0;
+    if(_state->hoursStored < HOURS_LIMIT) ++_state->hoursStored;
+}
+
+void PowerHistory::record(HeaterNum heater, Power power) {
+    std::uint32_t now = _state->epoch;
+    std::uint32_t last = _epochs[heater];
+
+    if(last >= now) return;
+
+    Sample sample = static_cast<Sample>(power);
+
+    // Секунды простоя после прошлой записи нулевые; в кольце секунд достаточно последних TIME_LIMIT
+    std::uint32_t idleFrom = std::max(last + 1, now > TIME_LIMIT ? now - TIME_LIMIT + 1 : 1u);
+
+    for(std::uint32_t second = idleFrom; second < now; ++second) {
+        _writeSecond(heater, second, 0);
+    }
+
+    _writeSecond(heater, now, sample);
+
+    if(last + 1 < now) _appendSeconds(heater, last + 1, now - 1, 0);
+
+    _appendSeconds(heater, now, now, sample);
+    _epochs[heater] = now;
+}
+
+std::uint32_t PowerHistory::getEpoch() const {
+    return _state->epoch;
+}
+
+Power PowerHistory::getPower(HeaterNum heater, unsigned short timeOffset) const {
+    if(timeOffset >= TIME_LIMIT || timeOffset < _idleSeconds(heater)) return 0;
+
+    return _log[static_cast<std::size_t>(_toSecond(timeOffset)) * _heatersNum + heater];
+}
+
+std::uint32_t PowerHistory::getPowerSum(HeaterNum heater, unsigned short fromOffset,
+                                        unsigned short toOffset) const {
+    fromOffset = std::max(fromOffset, _idleSeconds(heater));
+
+    if(fromOffset > toOffset || fromOffset >= TIME_LIMIT) return 0;
+
+    // Секунды до начала истории нулевые
+    if(fromOffset > _state->epoch) return 0;
+
+    toOffset = std::min<unsigned short>({toOffset, TIME_LIMIT - 1, static_cast<unsigned short>(
+            std::min<std::uint32_t>(_state->epoch, TIME_LIMIT))});
+
+    // Номера секунд от начала истории: блок k - секунды [k * SECONDS_PER_BLOCK, (k + 1) * SECONDS_PER_BLOCK)
+    std::uint32_t newest = _state->epoch - fromOffset;
+    std::uint32_t oldest = _state->epoch - toOffset;
+    std::uint32_t oldBlock = oldest / SECONDS_PER_BLOCK;
+    std::uint32_t newBlock = newest / SECONDS_PER_BLOCK;
+
+    if(newBlock - oldBlock < 2) return _sumSeconds(heater, oldest, newest);
+
+    // Полные блоки между краями - разность накопленных сумм по их концам
+    // (блок oldBlock завершён внутри интервала, поэтому его сумма ещё не перезаписана)
+    const Total* totals = &_blockTotals[static_cast<std::size_t>(heater) * BLOCKS_COUNT];
+    Total full = static_cast<Total>(totals[(newBlock - 1) % BLOCKS_COUNT] - totals[oldBlock % BLOCKS_COUNT]);
+
+    return _sumSeconds(heater, oldest, oldBlock * SECONDS_PER_BLOCK + SECONDS_PER_BLOCK - 1) + full +
+           _sumSeconds(heater, newBlock * SECONDS_PER_BLOCK, newest);
+}
+
+Power PowerHistory::getAveragePower(HeaterNum heater, unsigned short seconds) const {
+    if(seconds == 0) return 0;
+
+    std::uint32_t sum = getPowerSum(heater, 0, seconds - 1);
+
+    return (sum + seconds / 2) / seconds;
+}
+
+Power PowerHistory::getMinPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) const {
+    // Секунды за пределами истории и секунды простоя нулевые
+    if(toOffset >= TIME_LIMIT || fromOffset < _idleSeconds(heater)) return 0;
+
+    return _queryTree(_minTrees, heater, fromOffset, toOffset, minSelect);
+}
+
+Power PowerHistory::getMaxPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) const {
+    fromOffset = std::max(fromOffset, _idleSeconds(heater));
+
+    return _queryTree(_maxTrees, heater, fromOffset, toOffset, maxSelect);
+}
+
+PowerAggregate PowerHistory::getPowerAggregate(HeaterNum heater, std::uint32_t timeOffset) const {
+    PowerAggregate aggregate;
+
+    if(timeOffset < TIME_LIMIT) {
+        aggregate.sum = aggregate.min = aggregate.max = getPower(heater, timeOffset);
+        aggregate.seconds = 1;
+
+        return aggregate;
+    }
+
+    const std::uint32_t secondsPerHour = SECONDS_PER_MINUTE * MINUTES_PER_HOUR;
+    std::uint32_t last = _epochs[heater];
+    std::uint32_t minuteSeconds = _partialMinuteSeconds();
+
+    // Номер завершённой минуты, считая от последней
+    std::uint32_t minute = (timeOffset - std::min(timeOffset, minuteSeconds)) / SECONDS_PER_MINUTE;
+
+    if(minute < _state->minutesStored) {
+        aggregate.seconds = SECONDS_PER_MINUTE;
+
+        // Номер минуты от начала истории
+        std::uint32_t absolute = _state->epoch / SECONDS_PER_MINUTE - 1 - minute;
+
+        if((absolute + 1) * SECONDS_PER_MINUTE <= last) {
+            unsigned short column = (_state->minuteHead + MINUTES_LIMIT - minute) % MINUTES_LIMIT;
+            const MinuteAggregate& stored = _minutes[static_cast<std::size_t>(column) * _heatersNum + heater];
+
+            aggregate.sum = stored.sum;
+            aggregate.min = stored.min;
+            aggregate.max = stored.max;
+        } else if(last > 0 && absolute == (last - 1) / SECONDS_PER_MINUTE) {
+            // Минута не завершена записью нагревателя: её оставшиеся секунды нулевые
+            aggregate.sum = _partialMinutes[heater].sum;
+            aggregate.max = _partialMinutes[heater].max;
+        }
+
+        return aggregate;
+    }
+
+    std::uint32_t hourSeconds = _partialHourSeconds();
+    std::uint32_t hour = (timeOffset - std::min(timeOffset, hourSeconds)) / secondsPerHour;
+
+    if(hour < _state->hoursStored) {
+        aggregate.seconds = secondsPerHour;
+
+        std::uint32_t absolute = _state->epoch / secondsPerHour - 1 - hour;
+
+        if((absolute + 1) * secondsPerHour <= last) {
+            unsigned short column = (_state->hourHead + HOURS_LIMIT - hour) % HOURS_LIMIT;
+            const HourAggregate& stored = _hours[static_cast<std::size_t>(column) * _heatersNum + heater];
+
+            aggregate.sum = stored.sum;
+            aggregate.min = stored.min;
+            aggregate.max = stored.max;
+        } else if(last > 0 && absolute == (last - 1) / secondsPerHour) {
+            // Час не завершён записью нагревателя: к завершённым минутам часа
+            // добавляется незавершённая минута, остальное время нулевое
+            if(last / SECONDS_PER_MINUTE > absolute * MINUTES_PER_HOUR) {
+                aggregate.sum = _partialHours[heater].sum;
+                aggregate.max = _partialHours[heater].max;
+            }
+
+            if(last % SECONDS_PER_MINUTE) {
+                aggregate.sum += _partialMinutes[heater].sum;
+                aggregate.max = std::max<Power>(aggregate.max, _partialMinutes[heater].max);
+            }
+        }
+    }
+
+    return aggregate;
+}
+
+std::size_t PowerHistory::_bind(unsigned char* memory) {
+    const std::size_t columns = static_cast<std::size_t>(TIME_LIMIT) * _heatersNum;
+    std::size_t offset = 0;
+
+    _state = place<State>(memory, offset, 1);
+    _log = place<Sample>(memory, offset, columns);
+    _blockTotals = place<Total>(memory, offset, static_cast<std::size_t>(BLOCKS_COUNT) * _heatersNum);
+    _minTrees = place<Sample>(memory, offset, static_cast<std::size_t>(2 * BLOCKS_COUNT) * _heatersNum);
+    _maxTrees = place<Sample>(memory, offset, static_cast<std::size_t>(2 * BLOCKS_COUNT) * _heatersNum);
+    _partialMinutes = place<MinuteAggregate>(memory, offset, _heatersNum);
+    _partialHours = place<HourAggregate>(memory, offset, _heatersNum);
+    _minutes = place<MinuteAggregate>(memory, offset, static_cast<std::size_t>(MINUTES_LIMIT) * _heatersNum);
+    _hours = place<HourAggregate>(memory, offset, static_cast<std::size_t>(HOURS_LIMIT) * _heatersNum);
+    _powers = place<Sample>(memory, offset, _heatersNum);
+    _epochs = place<std::uint32_t>(memory, offset, _heatersNum);
+
+    return offset;
+}
+
+bool PowerHistory::_isCompatible(const unsigned char* memory) const {
+    const State* state = reinterpret_cast<const State*>(memory);
+
+    return state->magic == MAGIC && state->version == VERSION &&
+           state->heatersNum == _heatersNum && state->size == _size &&
+           state->minuteHead < MINUTES_LIMIT && state->hourHead < HOURS_LIMIT;
+}
+
+unsigned short PowerHistory::_toSecond(unsigned short timeOffset) const {
+    return (_state->epoch % TIME_LIMIT + TIME_LIMIT - timeOffset) % TIME_LIMIT;
+}
+
+unsigned short PowerHistory::_idleSeconds(HeaterNum heater) const {
+    return static_cast<unsigned short>(std::min<std::uint32_t>(_state->epoch - _epochs[heater], TIME_LIMIT));
+}
+
+void PowerHistory::_writeSecond(HeaterNum heater, std::uint32_t second, Sample sample) {
+    unsigned short column = static_cast<unsigned short>(second % TIME_LIMIT);
+
+    _log[static_cast<std::size_t>(column) * _heatersNum + heater] = sample;
+
+    if((column + 1) % SECONDS_PER_BLOCK == 0) _updateBlock(heater, column / SECONDS_PER_BLOCK);
+}
+
+std::uint32_t PowerHistory::_sumSeconds(HeaterNum heater, std::uint32_t from, std::uint32_t to) const {
+    std::uint32_t sum = 0;
+
+    for(std::uint32_t second = from; second <= to; ++second) {
+        sum += _log[static_cast<std::size_t>(second % TIME_LIMIT) * _heatersNum + heater];
+    }
+
+    return sum;
+}
+
+void PowerHistory::_updateBlock(HeaterNum heater, unsigned short block) {
+    const Sample* samples = &_log[static_cast<std::size_t>(block) * SECONDS_PER_BLOCK * _heatersNum + heater];
+    Sample min = samples[0];
+    Sample max = samples[0];
+    Total sum = samples[0];
+
+    for(unsigned short second = 1; second < SECONDS_PER_BLOCK; ++second) {
+        min = std::min(min, samples[second * _heatersNum]);
+        max = std::max(max, samples[second * _heatersNum]);
+        sum = static_cast<Total>(sum + samples[second * _heatersNum]);
+    }
+
+    // Блоки нагревателя заполняются по порядку: предыдущий блок кольца завершён раньше
+    Total* totals = &_blockTotals[static_cast<std::size_t>(heater) * BLOCKS_COUNT];
+
+    totals[block] = static_cast<Total>(totals[(block + BLOCKS_COUNT - 1) % BLOCKS_COUNT] + sum);
+
+    std::size_t tree = static_cast<std::size_t>(heater) * 2 * BLOCKS_COUNT;
+
+    _updateTree(&_minTrees[tree], block, min, minSelect);
+    _updateTree(&_maxTrees[tree], block, max, maxSelect);
+}
+
+void PowerHistory::_appendSeconds(HeaterNum heater, std::uint32_t from, std::uint32_t to, Sample sample) {
+    const std::uint32_t secondsPerHour = SECONDS_PER_MINUTE * MINUTES_PER_HOUR;
+    const std::uint32_t horizon = secondsPerHour * (HOURS_LIMIT + 1);
+
+    // Более старые секунды вытеснены из всех колец: начинаем с начала часа,
+    // после которого кольца минут и часов заполнятся целиком
+    if(to - from > horizon) {
+        from = (to - horizon) / secondsPerHour * secondsPerHour + 1;
+    }
+
+    MinuteAggregate& minute = _partialMinutes[heater];
+
+    while(from <= to) {
+        // Нулевой час, все минуты которого вытеснят из кольца минут следующие секунды интервала:
+        // его сводка сразу пишется в кольцо часов без обхода минут
+        if(sample == 0 && (from - 1) % secondsPerHour == 0
+           && to - from + 1 >= secondsPerHour + SECONDS_PER_MINUTE * MINUTES_LIMIT) {
+            std::uint32_t hour = (from - 1) / secondsPerHour;
+
+            _hours[static_cast<std::size_t>((hour + 1) % HOURS_LIMIT) * _heatersNum + heater] = HourAggregate();
+            from += secondsPerHour;
+
+            continue;
+        }
+
+        // Секунды нумеруются с единицы: минута m - секунды (60 * m, 60 * (m + 1)]
+        std::uint32_t minuteEnd = (from + SECONDS_PER_MINUTE - 1) / SECONDS_PER_MINUTE * SECONDS_PER_MINUTE;
+        std::uint32_t end = std::min(minuteEnd, to);
+        std::uint16_t sum = static_cast<std::uint16_t>(sample * (end - from + 1));
+
+        _accumulate(minute, sum, sample, sample, (from - 1) % SECONDS_PER_MINUTE == 0);
+
+        if(end == minuteEnd) _closeMinute(heater, minuteEnd / SECONDS_PER_MINUTE - 1);
+
+        from = end + 1;
+    }
+}
+
+void PowerHistory::_closeMinute(HeaterNum heater, std::uint32_t minute) {
+    const MinuteAggregate& aggregate = _partialMinutes[heater];
+
+    _minutes[static_cast<std::size_t>((minute + 1) % MINUTES_LIMIT) * _heatersNum + heater] = aggregate;
+
+    HourAggregate& hour = _partialHours[heater];
+    _accumulate(hour, aggregate.sum, aggregate.min, aggregate.max, minute % MINUTES_PER_HOUR == 0);
+
+    if((minute + 1) % MINUTES_PER_HOUR) return;
+
+    std::uint32_t column = (minute + 1) / MINUTES_PER_HOUR % HOURS_LIMIT;
+
+    _hours[static_cast<std::size_t>(column) * _heatersNum + heater] = hour;
+}
+
+std::uint32_t PowerHistory::_partialMinuteSeconds() const {
+    return _state->closingMinute ? 0 : _state->secondsInMinute;
+}
+
+std::uint32_t PowerHistory::_partialHourSeconds() const {
+    if(_state->closingHour) return 0;
+
+    // При завершении минуты она уже учтена в _state->minutesInHour
+    return static_cast<std::uint32_t>(_state->minutesInHour) * SECONDS_PER_MINUTE + _partialMinuteSeconds();
+}
+
+template<typename Aggregate, typename Sum>
+void PowerHistory::_accumulate(Aggregate& aggregate, Sum sum, Sample min, Sample max, bool first) {
+    if(first) {
+        aggregate.sum = sum;
+        aggregate.min = min;
+        aggregate.max = max;
+
+        return;
+    }
+
+    aggregate.sum += sum;
+    aggregate.min = std::min(aggregate.min, min);
+    aggregate.max = std::max(aggregate.max, max);
+}
+
+template<typename Select>
+void PowerHistory::_updateTree(Sample* tree, unsigned short block, Sample value, Select select) {
+    std::size_t node = BLOCKS_COUNT + block;
+
+    tree[node] = value;
+
+    for(node /= 2; node > 0; node /= 2) {
+        tree[node] = select(tree[2 * node], tree[2 * node + 1]);
+    }
+}
+
+template<typename Select>
+Power PowerHistory::_queryTree(const Sample* trees, HeaterNum heater,
+                               unsigned short fromOffset, unsigned short toOffset, Select select) const {
+    if(fromOffset > toOffset || fromOffset >= TIME_LIMIT) return 0;
+
+    toOffset = std::min<unsigned short>(toOffset, TIME_LIMIT - 1);
+
+    const Sample* tree = &trees[static_cast<std::size_t>(heater) * 2 * BLOCKS_COUNT];
+
+    // Старшее смещение - более ранний столбец
+    unsigned short from = _toSecond(toOffset);
+    unsigned short to = _toSecond(fromOffset);
+    Sample first = _log[static_cast<std::size_t>(to) * _heatersNum + heater];
+
+    if(from <= to) {
+        return _queryColumns(tree, heater, from, to + 1, first, select);
+    }
+
+    // Интервал проходит через конец кольца
+    Sample result = _queryColumns(tree, heater, from, TIME_LIMIT, first, select);
+
+    return _queryColumns(tree, heater, 0, to + 1, result, select);
+}
+
+template<typename Select>
+PowerHistory::Sample PowerHistory::_queryColumns(const Sample* tree, HeaterNum heater,
+                                                 unsigned short from, unsigned short to,
+                                                 Sample result, Select select) const {
+    // Неполные блоки на краях интервала
+    for(; from < to && from % SECONDS_PER_BLOCK; ++from) {
+        result = select(result, _log[static_cast<std::size_t>(from) * _heatersNum + heater]);
+    }
+
+    for(; from < to && to % SECONDS_PER_BLOCK; --to) {
+        result = select(result, _log[static_cast<std::size_t>(to - 1) * _heatersNum + heater]);
+    }
+
+    std::size_t left = BLOCKS_COUNT + from / SECONDS_PER_BLOCK;
+    std::size_t right = BLOCKS_COUNT + to / SECONDS_PER_BLOCK;
+
+    for(; left < right; left /= 2, right /= 2) {
+        if(left & 1u) result = select(result, tree[left++]);
+        if(right & 1u) result = select(result, tree[--right]);
+    }
+
+    return result;
+}
@@ -0,0 +1,425 @@
+#ifndef HEATERS_POWER_HISTORY_H
+#define HEATERS_POWER_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "variables_description.h"
+#include "mapped_file.h"
+
+/**
+ * Сводка мощностей нагревателя за интервал времени
+ */
+struct PowerAggregate {
+    /**
+     * Сумма мощностей за интервал (энергия в процент-секундах)
+     */
+    std::uint32_t sum = 0;
+    Power min = 0;
+    Power max = 0;
+    /**
+     * Длина интервала в секундах
+     */
+    std::uint32_t seconds = 0;
+};
+
+/**
+ * Результат подключения файла истории
+ */
+enum class HistoryFile {
+    /**
+     * Файл не удалось открыть, история остаётся в памяти процесса
+     */
+    FAILED,
+    /**
+     * Файл создан (или его содержимое несовместимо) и заполнен текущей историей
+     */
+    CREATED,
+    /**
+     * История и мощности восстановлены из файла
+     */
+    RESTORED
+};
+
+/**
+ * История мощностей всех нагревателей за последние TIME_LIMIT секунд.
+ *
+ * История хранится одним непрерывным кольцевым буфером из столбцов:
+ * столбец - мощности всех нагревателей за одну секунду (по одному байту на нагреватель).
+ * Голова кольца общая для всех нагревателей, поэтому начало новой секунды - это
+ * только сдвиг головы, а запись мощностей идёт подряд по одному столбцу.
+ *
+ * Для запросов по интервалам кольцо секунд делится на блоки из SECONDS_PER_BLOCK столбцов,
+ * и при заполнении каждого блока нагревателя обновляются:
+ *    - накопленная сумма мощностей по конец блока - сумма за O(SECONDS_PER_BLOCK):
+ *      полные блоки интервала - разность накопленных сумм, неполные на краях - по кольцу секунд;
+ *    - деревья отрезков минимумов и максимумов по блокам (своё на каждый нагреватель) -
+ *      минимум/максимум за O(SECONDS_PER_BLOCK + log BLOCKS_COUNT).
+ *
+ * На нагреватель приходится TIME_LIMIT байт мощностей, 2 * BLOCKS_COUNT байт накопленных сумм
+ * и 4 * BLOCKS_COUNT байт деревьев (1050 байт), 444 байта сводок минут и часов
+ * и 5 байт текущей мощности и номера секунды - около 1.5 КБ.
+ *
+ * Интервалы задаются смещениями как в getPower(): [fromOffset, toOffset] включительно,
+ * секунды за пределами истории считаются нулевыми.
+ *
+ * Более старая история хранится с пониженным разрешением:
+ *    - MINUTES_LIMIT последних завершённых минут (сумма, минимум, максимум);
+ *    - HOURS_LIMIT последних завершённых часов (сумма, минимум, максимум).
+ * Сводки накапливаются при записи каждой секунды в незавершённой минуте/часе нагревателя
+ * и переносятся в кольца минут/часов (тоже из столбцов с общей головой) при их завершении.
+ *
+ * История ведётся лениво: нагреватель помнит номер своей последней записанной секунды,
+ * а секунды после неё считаются нулевыми. Начало новой секунды не обходит нагреватели,
+ * а пропущенные нулевые секунды дописываются при следующей записи нагревателя.
+ * Поэтому простаивающие нагреватели ничего не стоят каждую секунду.
+ *
+ * Всё состояние истории (включая текущие мощности нагревателей) лежит в одном блоке
+ * памяти с версионированным заголовком. Блок можно отобразить на файл (attachFile),
+ * тогда история переживает перезапуск процесса: запись секунды остаётся записью
+ * в память, а восстановление - это проверка заголовка без разбора данных.
+ */
+class PowerHistory {
+public:
+    /**
+     * Максимальный лимит времени хранения истории мощности
+     *
+     * @note Единицы измерения - секунда
+     */
+    static const unsigned short TIME_LIMIT = POWER_HISTORY_SECONDS;
+
+    /**
+     * Количество хранимых завершённых минут
+     */
+    static const unsigned short MINUTES_LIMIT = 60;
+
+    /**
+     * Количество хранимых завершённых часов
+     */
+    static const unsigned short HOURS_LIMIT = 24;
+
+    static const unsigned short SECONDS_PER_MINUTE = 60;
+
+    static const unsigned short MINUTES_PER_HOUR = 60;
+
+    /**
+     * @param heatersNum - количество нагревателей
+     */
+    explicit PowerHistory(HeaterNum heatersNum);
+
+    PowerHistory(const PowerHistory&) = delete;
+    PowerHistory& operator=(const PowerHistory&) = delete;
+
+    /**
+     * Переносит историю в отображённый в память файл.
+     *
+     * Если в файле уже лежит история с той же версией формата и тем же количеством
+     * нагревателей, она заменяет текущую, иначе файл заполняется текущей историей.
+     *
+     * @note После FAILED история продолжает работать в памяти процесса
+     */
+    HistoryFile attachFile(const std::string& path);
+
+    /**
+     * Сохраняет текущую мощность нагревателя вместе с историей
+     */
+    void storePower(HeaterNum heater, Power power);
+
+    /**
+     * Возвращает сохранённую мощность нагревателя
+     */
+    Power getStoredPower(HeaterNum heater) const;
+
+    /**
+     * Начинает новую секунду истории.
+     *
+     * @note Мощность нагревателя, не записанная через record(), за эту секунду нулевая
+     */
+    void roll();
+
+    /**
+     * Записывает мощность нагревателя за последнюю завершённую секунду
+     *
+     * @note Вызывается после roll() не больше одного раза за секунду для нагревателя.
+     *       Сначала дописывает нулевые секунды после прошлой записи нагревателя.
+     *       Работа ограничена независимо от длины простоя: не больше TIME_LIMIT секунд кольца,
+     *       2 * MINUTES_PER_HOUR + MINUTES_LIMIT сводок минут и HOURS_LIMIT + 1 сводок часов
+     */
+    void record(HeaterNum heater, Power power);
+
+    /**
+     * Номер последней завершённой секунды (голова истории): её столбец - getEpoch() % TIME_LIMIT
+     */
+    std::uint32_t getEpoch() const;
+
+    /**
+     * Возвращает мощность нагревателя, выделенную timeOffset секунд назад
+     *
+     * @param timeOffset - 0: последняя завершённая секунда, 1: секунда до неё и т.д.
+     *
+     * @return 0, если timeOffset выходит за пределы истории
+     */
+    Power getPower(HeaterNum heater, unsigned short timeOffset = 0) const;
+
+    /**
+     * Возвращает сумму мощностей нагревателя за секунды [fromOffset, toOffset]
+     * (энергию в процент-секундах)
+     */
+    std::uint32_t getPowerSum(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) const;
+
+    /**
+     * Возвращает округлённую среднюю мощность нагревателя за последние seconds секунд
+     */
+    Power getAveragePower(HeaterNum heater, unsigned short seconds) const;
+
+    /**
+     * Возвращает минимальную мощность нагревателя за секунды [fromOffset, toOffset]
+     */
+    Power getMinPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) const;
+
+    /**
+     * Возвращает максимальную мощность нагревателя за секунды [fromOffset, toOffset]
+     */
+    Power getMaxPower(HeaterNum heater, unsigned short fromOffset, unsigned short toOffset) const;
+
+    /**
+     * Возвращает сводку мощностей нагревателя за интервал, содержащий секунду timeOffset назад.
+     *
+     * Уровень истории выбирается по смещению:
+     *    - последние TIME_LIMIT секунд - сводка за одну секунду;
+     *    - далее (начиная с последней завершённой минуты) - сводка за минуту;
+     *    - далее (начиная с последнего завершённого часа) - сводка за час.
+     *
+     * @param timeOffset - смещение в секундах, как в getPower()
+     *
+     * @return сводка с нулевой длиной, если смещение выходит за пределы всех уровней
+     */
+    PowerAggregate getPowerAggregate(HeaterNum heater, std::uint32_t timeOffset) const;
+
+private:
+    /**
+     * Мощность за секунду не превышает количества полупериодов в секунде
+     */
+    typedef unsigned char Sample;
+
+    /**
+     * Накопленная сумма мощностей по конец блока.
+     *
+     * @note Переполнение допустимо: разность двух сумм вычисляется по модулю 2^16
+     *       и верна, так как сумма за интервал не больше TIME_LIMIT * 100 < 2^16
+     */
+    typedef std::uint16_t Total;
+
+    static_assert(TIME_LIMIT * 100u < 65536u, "interval power sum must fit Total");
+
+    /**
+     * Количество столбцов кольца секунд в листе дерева отрезков
+     */
+    static const unsigned short SECONDS_PER_BLOCK = 8;
+
+    static const unsigned short BLOCKS_COUNT = TIME_LIMIT / SECONDS_PER_BLOCK;
+
+    static_assert(TIME_LIMIT % SECONDS_PER_BLOCK == 0, "seconds ring must consist of whole blocks");
+
+    /**
+     * Заголовок блока истории.
+     *
+     * @note Формат блока определяется VERSION: при любом изменении раскладки
+     *       блока или заголовка версию нужно увеличить
+     */
+    struct State {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t heatersNum;
+        /**
+         * Номер последней завершённой секунды (количество вызовов roll),
+         * её столбец - epoch % TIME_LIMIT
+         */
+        std::uint32_t epoch;
+        std::uint64_t size;
+
+        /**
+         * Количество секунд в текущей минуте и завершённых минут в текущем часе
+         */
+        std::uint16_t secondsInMinute;
+        std::uint16_t minutesInHour;
+        std::uint16_t minuteHead;
+        std::uint16_t hourHead;
+        /**
+         * Количество заполненных столбцов колец минут и часов
+         */
+        std::uint16_t minutesStored;
+        std::uint16_t hoursStored;
+        /**
+         * Записываемая секунда завершает минуту/час
+         */
+        std::uint8_t closingMinute;
+        std::uint8_t closingHour;
+    };
+
+    static const std::uint32_t MAGIC = 0x54534850; // "PHST"
+    static const std::uint32_t VERSION = 4;
+
+    /**
+     * Сводка за минуту: сумма 60 отсчётов помещается в 16 бит
+     */
+    struct MinuteAggregate {
+        std::uint16_t sum;
+        Sample min;
+        Sample max;
+    };
+
+    /**
+     * Сводка за час
+     */
+    struct HourAggregate {
+        std::uint32_t sum;
+        Sample min;
+        Sample max;
+    };
+
+private:
+    /**
+     * Раскладывает массивы истории по блоку memory
+     *
+     * @param memory - начало блока или nullptr, чтобы только вычислить размер
+     *
+     * @return размер блока
+     */
+    std::size_t _bind(unsigned char* memory);
+
+    /**
+     * Проверяет, что в блоке лежит совместимая история
+     */
+    bool _isCompatible(const unsigned char* memory) const;
+
+    /**
+     * Переводит смещение во времени в номер столбца кольца
+     */
+    unsigned short _toSecond(unsigned short timeOffset) const;
+
+    /**
+     * Количество последних секунд, в которые нагреватель не записывался
+     * (не больше TIME_LIMIT): их мощности нулевые
+     */
+    unsigned short _idleSeconds(HeaterNum heater) const;
+
+    /**
+     * Записывает секунду second в кольцо секунд нагревателя
+     */
+    void _writeSecond(HeaterNum heater, std::uint32_t second, Sample sample);
+
+    /**
+     * Возвращает сумму мощностей нагревателя за секунды [from, to] (номера от начала истории)
+     * по кольцу секунд
+     */
+    std::uint32_t _sumSeconds(HeaterNum heater, std::uint32_t from, std::uint32_t to) const;
+
+    /**
+     * Добавляет секунды [from, to] с одинаковой мощностью к сводкам минут и часов нагревателя
+     */
+    void _appendSeconds(HeaterNum heater, std::uint32_t from, std::uint32_t to, Sample sample);
+
+    /**
+     * Переносит сводку завершённой минуты minute (номер от начала истории) в кольцо минут
+     * и в сводку часа, а при завершении часа - сводку часа в кольцо часов
+     */
+    void _closeMinute(HeaterNum heater, std::uint32_t minute);
+
+    /**
+     * Количество секунд незавершённой минуты, уже записанных в историю
+     */
+    std::uint32_t _partialMinuteSeconds() const;
+
+    /**
+     * Количество секунд незавершённого часа, уже записанных в историю
+     */
+    std::uint32_t _partialHourSeconds() const;
+
+    /**
+     * Добавляет сводку меньшего уровня к сводке незавершённого интервала
+     */
+    template<typename Aggregate, typename Sum>
+    static void _accumulate(Aggregate& aggregate, Sum sum, Sample min, Sample max, bool first);
+
+    /**
+     * Пересчитывает накопленную сумму и минимум/максимум заполненного блока кольца секунд нагревателя
+     */
+    void _updateBlock(HeaterNum heater, unsigned short block);
+
+    /**
+     * Обновляет лист дерева отрезков и его предков
+     *
+     * @param tree - дерево нагревателя (2 * BLOCKS_COUNT узлов)
+     */
+    template<typename Select>
+    static void _updateTree(Sample* tree, unsigned short block, Sample value, Select select);
+
+    /**
+     * Возвращает минимум/максимум по интервалу смещений
+     */
+    template<typename Select>
+    Power _queryTree(const Sample* trees, HeaterNum heater,
+                     unsigned short fromOffset, unsigned short toOffset, Select select) const;
+
+    /**
+     * Возвращает минимум/максимум по интервалу столбцов [from, to):
+     * неполные блоки на краях - по кольцу секунд, остальные - по дереву
+     */
+    template<typename Select>
+    Sample _queryColumns(const Sample* tree, HeaterNum heater, unsigned short from, unsigned short to,
+                         Sample result, Select select) const;
+
+private:
+    HeaterNum _heatersNum;
+    /**
+     * Размер блока истории в байтах
+     */
+    std::size_t _size;
+    /**
+     * Блок истории в памяти процесса (пока не подключён файл)
+     */
+    std::vector<std::uint64_t> _heap;
+    MappedFile _file;
+
+    State* _state = nullptr;
+    /**
+     * _log[second * _heatersNum + heater]
+     */
+    Sample* _log = nullptr;
+    /**
+     * _blockTotals[heater * BLOCKS_COUNT + block] - сумма мощностей нагревателя
+     * по последнюю секунду блока включительно (записывается вместе с последним столбцом блока)
+     */
+    Total* _blockTotals = nullptr;
+    /**
+     * Деревья отрезков по блокам: _minTrees[heater * 2 * BLOCKS_COUNT + node]
+     *
+     * @note Лист блока обновляется при записи его последнего столбца: до этого
+     *       блок целиком в интервал запроса не попадает
+     */
+    Sample* _minTrees = nullptr;
+    Sample* _maxTrees = nullptr;
+    /**
+     * Сводки незавершённых минуты и часа каждого нагревателя
+     */
+    MinuteAggregate* _partialMinutes = nullptr;
+    HourAggregate* _partialHours = nullptr;
+    /**
+     * _minutes[minute * _heatersNum + heater], _hours[hour * _heatersNum + heater]
+     */
+    MinuteAggregate* _minutes = nullptr;
+    HourAggregate* _hours = nullptr;
+    /**
+     * Текущие мощности нагревателей
+     */
+    Sample* _powers = nullptr;
+    /**
+     * Номер последней записанной секунды каждого нагревателя (0 - не записывался)
+     */
+    std::uint32_t* _epochs = nullptr;
+};
+
+#endif //HEATERS_POWER_HISTORY_H
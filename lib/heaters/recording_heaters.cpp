@@ -0,0 +1,53 @@
+#include "recording_heaters.h"
+
+RecordingHeaters::RecordingHeaters(HeaterNum heatersNum, IHeatSink& sink,
+                                   std::size_t recordCapacity, ScheduleLayout layout)
+        : _heatersNum(heatersNum), _digest(&sink), _heaters(heatersNum, _digest, layout),
+          _recorder(heatersNum, layout, recordCapacity) {
+}
+
+void RecordingHeaters::setPower(HeaterNum heater, Power power) {
+    if(heater >= _heatersNum || power > Heater::MAXIMUM_POWER) return;
+
+    _recorder.recordSetPower(heater, power);
+    _heaters.setPower(heater, power);
+}
+
+bool RecordingHeaters::setPowers(const HeaterPowers& powers, PowersCommit commit) {
+    if(!_heaters.setPowers(powers, commit)) return false;
+
+    _recorder.recordSetPowers(powers, commit);
+
+    return true;
+}
+
+void RecordingHeaters::getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum heater, Power power,
+                                                                unsigned int& top, unsigned int& bot) {
+    _heaters.getMaxNumOfTurnedHeatersAfterPowerChange(heater, power, top, bot);
+}
+
+Power RecordingHeaters::getPower(HeaterNum heater, unsigned short timeOffset) {
+    return _heaters.getPower(heater, timeOffset);
+}
+
+bool RecordingHeaters::getLastSemiPeriodState(HeaterNum heaterNum) {
+    return _heaters.getLastSemiPeriodState(heaterNum);
+}
+
+void RecordingHeaters::zeroCrossed() {
+    _heaters.zeroCrossed();
+    _recorder.recordZeroCrossed();
+
+    // Секунда завершилась - история мощностей сдвинулась
+    if(_heaters.getCurrentFrame() == 0) {
+        _recorder.recordCheckpoint(_digest.take(), StatesDigest::digestPowers(_heaters, _heatersNum));
+    }
+}
+
+Heaters& RecordingHeaters::getHeaters() {
+    return _heaters;
+}
+
+EventRecorder& RecordingHeaters::getRecorder() {
+    return _recorder;
+}
@@ -0,0 +1,68 @@
+#ifndef HEATERS_RECORDING_HEATERS_H
+#define HEATERS_RECORDING_HEATERS_H
+
+#include <cstddef>
+
+#include "variables_description.h"
+#include "event_recorder.h"
+#include "heaters.h"
+
+/**
+ * Модуль Heaters, записывающий свои вызовы (см. EventRecorder).
+ *
+ * Каждую секунду в запись добавляется контрольная точка со свёрткой состояний,
+ * переданных приёмнику за секунду, и свёрткой мощностей getPower - по ним
+ * replayRecording сверяет воспроизведение.
+ */
+class RecordingHeaters : public IHeaters {
+public:
+    /**
+     * Размер буфера записи по умолчанию
+     */
+    static const std::size_t DEFAULT_RECORD_CAPACITY = 1 << 20;
+
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param sink - приёмник упакованных состояний нагревателей
+     *
+     * @param recordCapacity - размер буфера записи в байтах
+     *
+     * @param layout - способ раскладки нагревателей по полупериодам
+     */
+    RecordingHeaters(HeaterNum heatersNum,
+                     IHeatSink& sink,
+                     std::size_t recordCapacity = DEFAULT_RECORD_CAPACITY,
+                     ScheduleLayout layout = ScheduleLayout::SEQUENTIAL);
+
+    /**
+     * @note Вызов с некорректным нагревателем или мощностью не выполняется и не записывается
+     */
+    void setPower(HeaterNum heater, Power power) override;
+
+    bool setPowers(const HeaterPowers& powers, PowersCommit commit = PowersCommit::NEXT_FRAME) override;
+
+    void getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum heater, Power power,
+                                                  unsigned int& top, unsigned int& bot) override;
+
+    Power getPower(HeaterNum heater, unsigned short timeOffset = 0) override;
+
+    bool getLastSemiPeriodState(HeaterNum heaterNum) override;
+
+    void zeroCrossed();
+
+    /**
+     * Модуль, выполняющий вызовы (запросы к нему напрямую не записываются)
+     */
+    Heaters& getHeaters();
+
+    EventRecorder& getRecorder();
+
+private:
+    HeaterNum _heatersNum;
+    StatesDigest _digest;
+    Heaters _heaters;
+    EventRecorder _recorder;
+};
+
+#endif //HEATERS_RECORDING_HEATERS_H
@@ -0,0 +1,228 @@
+#include "schedule_builder.h"
+
+ScheduleBuilder::ScheduleBuilder(HeaterNum heatersNum, const HeatSchedule& schedule, PowersCommit policy)
+        : _policy(policy), _buffers{{schedule, {}}, {schedule, {}}}, _targetCommit(policy) {
+    _target.reserve(heatersNum);
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        _target.push_back(schedule.getPower(heater));
+    }
+
+    for(Buffer& buffer: _buffers) {
+        buffer.changed.reserve(heatersNum);
+    }
+
+    _snapshot.resize(heatersNum);
+    _changes.reserve(heatersNum);
+    _published = _target;
+    _isChanged.resize(heatersNum, 0);
+
+    // Первый буфер - задний буфер потока построения, второй свободен
+    _free.store(&_buffers[1], std::memory_order_relaxed);
+    _thread = std::thread(&ScheduleBuilder::_run, this);
+}
+
+ScheduleBuilder::~ScheduleBuilder() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+
+    _wake.notify_one();
+    _thread.join();
+}
+
+void ScheduleBuilder::request(HeaterNum heater, Power power) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _target[heater] = power;
+        ++_requested;
+    }
+
+    _wake.notify_one();
+}
+
+void ScheduleBuilder::request(const HeaterPowers& powers, PowersCommit commit) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        for(const auto& heaterAndPower: powers) {
+            _target[heaterAndPower.first] = heaterAndPower.second;
+        }
+
+        if(commit == PowersCommit::NEXT_SECOND) _targetCommit = commit;
+
+        ++_requested;
+    }
+
+    _wake.notify_one();
+}
+
+bool ScheduleBuilder::acquire(HeatSchedule& schedule, bool secondBoundary, std::vector<HeaterNum>& changed) {
+    Slot ready = _ready.load(std::memory_order_acquire);
+
+    if(!ready) return false;
+
+    // Момент вступления в силу читается из того же слова, что и буфер:
+    // если поток построения успел заменить схему, замена не пройдёт и схема заберётся в следующий раз
+    if(_commit(ready) == PowersCommit::NEXT_SECOND && !secondBoundary) return false;
+    if(!_ready.compare_exchange_strong(ready, 0, std::memory_order_acq_rel)) return false;
+
+    Buffer* buffer = _buffer(ready);
+
+    std::swap(schedule, buffer->schedule);
+    changed.assign(buffer->changed.begin(), buffer->changed.end());
+    _release(buffer);
+
+    return true;
+}
+
+bool ScheduleBuilder::take(HeatSchedule& schedule, PowersCommit& commit, std::vector<HeaterNum>& changed) {
+    Slot ready = _ready.exchange(0, std::memory_order_acq_rel);
+
+    if(!ready) return false;
+
+    Buffer* buffer = _buffer(ready);
+
+    std::swap(schedule, buffer->schedule);
+    commit = _commit(ready);
+    changed.assign(buffer->changed.begin(), buffer->changed.end());
+    _release(buffer);
+
+    return true;
+}
+
+void ScheduleBuilder::wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    _idle.wait(lock, [this]() { return _built == _requested; });
+}
+
+std::uint64_t ScheduleBuilder::getBuildsCount() const {
+    return _buildsCount.load(std::memory_order_relaxed);
+}
+
+void ScheduleBuilder::_run() {
+    Buffer* back = &_buffers[0];
+
+    for(;;) {
+        std::uint64_t requested = 0;
+        PowersCommit commit = _policy;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _wake.wait(lock, [this]() { return _stopping || _built != _requested; });
+
+            if(_built == _requested) return;
+
+            // Забираем последние мощности: всё, что придёт дальше, попадёт в следующую схему
+            _snapshot = _target;
+            commit = _targetCommit;
+            _targetCommit = _policy;
+            requested = _requested;
+        }
+
+        _changes.clear();
+
+        for(HeaterNum heater = 0; heater < _snapshot.size(); ++heater) {
+            if(back->schedule.getPower(heater) != _snapshot[heater]) {
+                _changes.emplace_back(heater, _snapshot[heater]);
+            }
+        }
+
+        back->schedule.setPowers(_changes);
+        _listChanges(back);
+        back = _publish(back, commit);
+        _buildsCount.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _built = requested;
+        }
+
+        _idle.notify_all();
+    }
+}
+
+void ScheduleBuilder::_listChanges(Buffer* built) {
+    built->changed.clear();
+
+    auto add = [this, built](HeaterNum heater) {
+        if(_isChanged[heater]) return;
+
+        _isChanged[heater] = true;
+        built->changed.push_back(heater);
+    };
+
+    for(HeaterNum heater = 0; heater < _snapshot.size(); ++heater) {
+        if(_snapshot[heater] != _published[heater]) add(heater);
+    }
+
+    // Если прошлая схема ещё не забрана, новая может её заменить: тогда у потока перехода
+    // через ноль останется схема до неё, поэтому её изменения тоже входят в список.
+    // Поток перехода через ноль список только читает, даже если заберёт её прямо сейчас
+    if(Slot pending = _ready.load(std::memory_order_acquire)) {
+        for(HeaterNum heater: _buffer(pending)->changed) {
+            add(heater);
+        }
+    }
+
+    for(HeaterNum heater: built->changed) {
+        _isChanged[heater] = false;
+    }
+
+    _published = _snapshot;
+}
+
+ScheduleBuilder::Buffer* ScheduleBuilder::_publish(Buffer* built, PowersCommit commit) {
+    Slot replaced = _ready.load(std::memory_order_acquire);
+
+    for(;;) {
+        // Новая схема содержит мощности незабранной, поэтому наследует её момент вступления в силу
+        bool inherit = replaced && _commit(replaced) == PowersCommit::NEXT_SECOND;
+        Slot slot = _slot(built, inherit ? PowersCommit::NEXT_SECOND : commit);
+
+        if(_ready.compare_exchange_weak(replaced, slot, std::memory_order_acq_rel)) break;
+    }
+
+    if(replaced) return _buffer(replaced);
+
+    // Второй буфер у потока перехода через ноль: он вернёт его сразу после обмена схемами
+    if(Buffer* free = _free.exchange(nullptr)) return free;
+
+    std::unique_lock<std::mutex> lock(_freeMutex);
+    Buffer* free = nullptr;
+
+    _freeWaiting.store(true);
+    _freed.wait(lock, [this, &free]() {
+        free = _free.exchange(nullptr);
+        return free != nullptr;
+    });
+    _freeWaiting.store(false, std::memory_order_relaxed);
+
+    return free;
+}
+
+void ScheduleBuilder::_release(Buffer* buffer) {
+    // Последовательная согласованность: либо поток построения увидит буфер,
+    // либо этот поток увидит, что тот ждёт, и разбудит его под мьютексом
+    _free.store(buffer);
+
+    if(_freeWaiting.load()) {
+        std::lock_guard<std::mutex> lock(_freeMutex);
+        _freed.notify_one();
+    }
+}
+
+ScheduleBuilder::Slot ScheduleBuilder::_slot(Buffer* buffer, PowersCommit commit) {
+    return reinterpret_cast<Slot>(buffer) | (commit == PowersCommit::NEXT_SECOND ? NEXT_SECOND_BIT : 0);
+}
+
+ScheduleBuilder::Buffer* ScheduleBuilder::_buffer(Slot slot) {
+    return reinterpret_cast<Buffer*>(slot & ~NEXT_SECOND_BIT);
+}
+
+PowersCommit ScheduleBuilder::_commit(Slot slot) {
+    return slot & NEXT_SECOND_BIT ? PowersCommit::NEXT_SECOND : PowersCommit::NEXT_FRAME;
+}
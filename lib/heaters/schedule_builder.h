@@ -0,0 +1,203 @@
+#ifndef HEATERS_SCHEDULE_BUILDER_H
+#define HEATERS_SCHEDULE_BUILDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "variables_description.h"
+#include "heat_schedule.h"
+#include "heaters.h"
+
+/**
+ * Фоновое построение схемы нагревания.
+ *
+ * Запросы мощностей из любых потоков только обновляют целевые мощности под мьютексом
+ * и будят поток построения, поэтому запросы, пришедшие во время построения,
+ * объединяются: строятся только последние мощности.
+ *
+ * Схема строится в задний буфер и публикуется одной атомарной заменой указателя
+ * на готовый буфер. Если прошлая готовая схема ещё не забрана, она заменяется новой.
+ * Поток перехода через ноль забирает готовый буфер (acquire), меняет его содержимое
+ * местами со своей текущей схемой (без выделения памяти) и возвращает буфер потоку построения.
+ *
+ * Вместе со схемой публикуется список нагревателей, мощность которых в ней может отличаться
+ * от схемы потока перехода через ноль, поэтому переход на новую схему стоит O(изменений).
+ * Поток построения не крутится в ожидании возвращённого буфера, а спит на условной переменной.
+ */
+class ScheduleBuilder {
+public:
+    /**
+     * @param heatersNum - количество нагревателей
+     *
+     * @param schedule - текущая схема (образец буферов: раскладка, группы нагрузки и мощности)
+     *
+     * @param policy - момент вступления в силу построенных схем
+     */
+    ScheduleBuilder(HeaterNum heatersNum, const HeatSchedule& schedule, PowersCommit policy);
+
+    /**
+     * Строит оставшиеся запросы и останавливает поток построения
+     */
+    ~ScheduleBuilder();
+
+    ScheduleBuilder(const ScheduleBuilder&) = delete;
+    ScheduleBuilder& operator=(const ScheduleBuilder&) = delete;
+
+    /**
+     * Запрашивает мощность нагревателя
+     *
+     * @note Вызывается из любого потока, корректность мощности проверяет вызывающий
+     */
+    void request(HeaterNum heater, Power power);
+
+    /**
+     * Запрашивает набор мощностей
+     *
+     * @note Набор попадает в одну схему целиком. Если набор (или объединённый с ним запрос)
+     *       требует NEXT_SECOND, схема вступает в силу с начала секунды
+     */
+    void request(const HeaterPowers& powers, PowersCommit commit);
+
+    /**
+     * Забирает готовую схему, если она есть и может вступить в силу
+     *
+     * @note Вызывается только из потока перехода через ноль
+     *
+     * @param[in,out] schedule - текущая схема; меняется местами с готовой
+     *
+     * @param secondBoundary - начинается новая секунда
+     *
+     * @param[out] changed - нагреватели, мощность которых могла измениться
+     *             (ёмкость должна быть не меньше количества нагревателей)
+     *
+     * @return true, если схема заменена
+     */
+    bool acquire(HeatSchedule& schedule, bool secondBoundary, std::vector<HeaterNum>& changed);
+
+    /**
+     * Забирает готовую схему независимо от момента её вступления в силу
+     *
+     * @note Вызывается только из потока перехода через ноль, обычно перед остановкой
+     *
+     * @param[out] commit - момент, с которого схема должна вступить в силу
+     *
+     * @param[out] changed - нагреватели, мощность которых могла измениться
+     *
+     * @return true, если схема заменена
+     */
+    bool take(HeatSchedule& schedule, PowersCommit& commit, std::vector<HeaterNum>& changed);
+
+    /**
+     * Ждёт, пока построены и опубликованы все сделанные запросы
+     */
+    void wait();
+
+    /**
+     * Количество построенных схем
+     */
+    std::uint64_t getBuildsCount() const;
+
+private:
+    struct Buffer {
+        HeatSchedule schedule;
+        /**
+         * Нагреватели, мощность которых может отличаться от схемы потока перехода через ноль
+         */
+        std::vector<HeaterNum> changed;
+    };
+
+    /**
+     * Готовая схема публикуется вместе с моментом её вступления в силу:
+     * младший бит указателя на буфер (буферы выровнены) - признак NEXT_SECOND
+     */
+    typedef std::uintptr_t Slot;
+
+    static const Slot NEXT_SECOND_BIT = 1;
+
+    static_assert(alignof(Buffer) > NEXT_SECOND_BIT, "buffer address must leave the commit bit free");
+
+private:
+    /**
+     * Цикл потока построения
+     */
+    void _run();
+
+    /**
+     * Заполняет список изменений построенного буфера относительно схемы,
+     * которая будет у потока перехода через ноль, когда он заберёт буфер
+     */
+    void _listChanges(Buffer* built);
+
+    /**
+     * Публикует построенный буфер и возвращает буфер для следующего построения
+     */
+    Buffer* _publish(Buffer* built, PowersCommit commit);
+
+    /**
+     * Возвращает забранный буфер потоку построения
+     *
+     * @note Вызывается только из потока перехода через ноль
+     */
+    void _release(Buffer* buffer);
+
+    static Slot _slot(Buffer* buffer, PowersCommit commit);
+
+    static Buffer* _buffer(Slot slot);
+
+    static PowersCommit _commit(Slot slot);
+
+private:
+    PowersCommit _policy;
+    Buffer _buffers[2];
+    /**
+     * Готовая схема (см. Slot) или 0
+     */
+    std::atomic<Slot> _ready{0};
+    /**
+     * Буфер, возвращённый потоком перехода через ноль, или nullptr
+     */
+    std::atomic<Buffer*> _free{nullptr};
+    /**
+     * Поток построения ждёт возвращения буфера: только тогда поток перехода через ноль
+     * берёт _freeMutex, чтобы разбудить его
+     */
+    std::atomic<bool> _freeWaiting{false};
+    std::mutex _freeMutex;
+    std::condition_variable _freed;
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    /**
+     * Целевые мощности и момент их вступления в силу (под _mutex)
+     */
+    std::vector<Power> _target;
+    PowersCommit _targetCommit;
+    /**
+     * Номера последнего запроса и последнего построенного запроса (под _mutex)
+     */
+    std::uint64_t _requested = 0;
+    std::uint64_t _built = 0;
+    bool _stopping = false;
+    std::atomic<std::uint64_t> _buildsCount{0};
+
+    /**
+     * Рабочие массивы потока построения
+     */
+    std::vector<Power> _snapshot;
+    HeaterPowers _changes;
+    /**
+     * Мощности последней опубликованной схемы и отметки нагревателей списка изменений
+     * (только для потока построения)
+     */
+    std::vector<Power> _published;
+    std::vector<unsigned char> _isChanged;
+
+    std::thread _thread;
+};
+
+#endif //HEATERS_SCHEDULE_BUILDER_H
@@ -0,0 +1,83 @@
+#ifndef HEATERS_SEQ_LOCK_H
+#define HEATERS_SEQ_LOCK_H
+
+#include <atomic>
+#include <thread>
+
+/**
+ * Последовательная блокировка (seqlock) для одного писателя и любого количества читателей.
+ *
+ * Писатель никогда не ждёт читателей: перед изменением данных он делает счётчик нечётным,
+ * после - снова чётным. Читатель повторяет чтение, пока не получит значение,
+ * во время чтения которого счётчик не менялся и был чётным.
+ *
+ * @note Читаемые данные должны допускать чтение "на лету" (в т.ч. разорванное):
+ *       результат такого чтения отбрасывается и чтение повторяется
+ */
+class SeqLock {
+public:
+    void beginWrite() {
+        _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void endWrite() {
+        _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Выполняет read() до получения согласованного результата
+     *
+     * @note Пока идёт запись, читатель уступает процессор писателю
+     */
+    template<typename Read>
+    auto read(Read&& read) const -> decltype(read()) {
+        for(;;) {
+            unsigned sequence = _sequence.load(std::memory_order_acquire);
+
+            if(sequence & 1u) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            auto result = read();
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(_sequence.load(std::memory_order_relaxed) == sequence) return result;
+        }
+    }
+
+    /**
+     * Выполняет read() не больше attempts раз
+     *
+     * @note Используется читателями в другом процессе: если писатель завершился посреди записи,
+     *       счётчик навсегда остаётся нечётным и read() зациклился бы
+     *
+     * @return false, если согласованный результат не получен
+     */
+    template<typename Read>
+    bool tryRead(Read&& read, unsigned attempts) const {
+        for(unsigned attempt = 0; attempt < attempts; ++attempt) {
+            unsigned sequence = _sequence.load(std::memory_order_acquire);
+
+            if(sequence & 1u) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            read();
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            if(_sequence.load(std::memory_order_relaxed) == sequence) return true;
+        }
+
+        return false;
+    }
+
+private:
+    std::atomic<unsigned> _sequence{0};
+};
+
+#endif //HEATERS_SEQ_LOCK_H
@@ -0,0 +1,197 @@
+#include "state_mirror.h"
+
+#include <algorithm>
+#include <new>
+
+#include "bit_operations.h"
+
+bool StateMirrorSnapshot::getLastSemiPeriodState(HeaterNum heater) const {
+    return (lastStates[heater / HEAT_STATE_WORD_BITS] >> (heater % HEAT_STATE_WORD_BITS)) & 1u;
+}
+
+StateMirror::~StateMirror() {
+    close();
+}
+
+bool StateMirror::open(const std::string& name, HeaterNum heatersNum) {
+    close();
+
+    std::size_t wordsCount = (heatersNum + HEAT_STATE_WORD_BITS - 1) / HEAT_STATE_WORD_BITS;
+
+    if(!_segment.createShared(name, _segmentSize(heatersNum, wordsCount))) return false;
+
+    // Новый сегмент заполнен нулями: нулевые мощности и выключенные нагреватели
+    _name = name;
+    _header = new(_segment.getData()) Header();
+    _header->version = VERSION;
+    _header->heatersNum = heatersNum;
+    _header->wordsCount = static_cast<std::uint32_t>(wordsCount);
+    _powers = _segment.getData() + _powersOffset();
+    _lastStates = reinterpret_cast<HeatStateWord*>(_segment.getData() + _statesOffset(heatersNum));
+    _retiredWords.clear();
+    _retiredWords.reserve(wordsCount);
+    _isRetired.assign(wordsCount, 0);
+    _pendingPowers = std::vector<std::atomic<unsigned char>>(heatersNum);
+    _changedBlocks = std::vector<std::atomic<std::uint64_t>>(
+            (heatersNum + POWERS_BLOCK * 64 - 1) / (POWERS_BLOCK * 64));
+
+    // Читатель принимает сегмент только после записи сигнатуры
+    _header->magic.store(MAGIC, std::memory_order_release);
+
+    return true;
+}
+
+void StateMirror::close() {
+    if(!isOpen()) return;
+
+    _segment.close();
+    MappedFile::unlinkShared(_name);
+    _header = nullptr;
+    _powers = nullptr;
+    _lastStates = nullptr;
+}
+
+bool StateMirror::isOpen() const {
+    return _header != nullptr;
+}
+
+void StateMirror::storePower(HeaterNum heater, Power power) {
+    _pendingPowers[heater].store(static_cast<unsigned char>(power), std::memory_order_relaxed);
+    _markPower(heater);
+}
+
+void StateMirror::storePowers(const HeatSchedule& schedule) {
+    for(HeaterNum heater = 0; heater < _header->heatersNum; ++heater) {
+        _pendingPowers[heater].store(static_cast<unsigned char>(schedule.getPower(heater)),
+                                     std::memory_order_relaxed);
+    }
+
+    for(HeaterNum heater = 0; heater < _header->heatersNum; heater += POWERS_BLOCK) {
+        _markPower(heater);
+    }
+}
+
+void StateMirror::retireWord(HeaterNum word) {
+    if(_isRetired[word]) return;
+
+    _isRetired[word] = true;
+    _retiredWords.push_back(word);
+}
+
+void StateMirror::publishFrame(const HeatStateWord* states, const HeatStateWord* changed,
+                               const HeaterNum* activeWords, std::size_t activeCount,
+                               Frame frame, std::uint32_t historyEpoch) {
+    _header->seqLock.beginWrite();
+
+    // Состояние до последнего полупериода - текущее состояние с отменённым изменением
+    for(std::size_t active = 0; active < activeCount; ++active) {
+        HeaterNum word = activeWords[active];
+
+        _lastStates[word] = states[word] ^ changed[word];
+    }
+
+    // Слово исключается из активных, когда его состояния и изменения нулевые
+    for(HeaterNum word: _retiredWords) {
+        _lastStates[word] = states[word] ^ changed[word];
+        _isRetired[word] = false;
+    }
+
+    _retiredWords.clear();
+
+    _flushPowers();
+
+    _header->frame = frame;
+    _header->historyEpoch = historyEpoch;
+    ++_header->frames;
+
+    _header->seqLock.endWrite();
+}
+
+void StateMirror::_markPower(HeaterNum heater) {
+    HeaterNum block = heater / POWERS_BLOCK;
+
+    // release: мощность блока видна тому, кто увидит признак
+    _changedBlocks[block / 64].fetch_or(std::uint64_t(1) << (block % 64), std::memory_order_release);
+}
+
+void StateMirror::_flushPowers() {
+    for(std::size_t mask = 0; mask < _changedBlocks.size(); ++mask) {
+        std::uint64_t changed = _changedBlocks[mask].exchange(0, std::memory_order_acquire);
+
+        while(changed) {
+            HeaterNum block = static_cast<HeaterNum>(mask * 64 + countTrailingZeros(changed));
+            HeaterNum first = block * POWERS_BLOCK;
+            HeaterNum last = std::min<HeaterNum>(first + POWERS_BLOCK, _header->heatersNum);
+
+            changed &= changed - 1;
+
+            for(HeaterNum heater = first; heater < last; ++heater) {
+                _powers[heater] = _pendingPowers[heater].load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+std::size_t StateMirror::_powersOffset() {
+    return sizeof(Header);
+}
+
+std::size_t StateMirror::_statesOffset(HeaterNum heatersNum) {
+    return (_powersOffset() + heatersNum + alignof(HeatStateWord) - 1) / alignof(HeatStateWord)
+           * alignof(HeatStateWord);
+}
+
+std::size_t StateMirror::_segmentSize(HeaterNum heatersNum, std::size_t wordsCount) {
+    return _statesOffset(heatersNum) + wordsCount * sizeof(HeatStateWord);
+}
+
+bool StateMirrorReader::open(const std::string& name) {
+    _header = nullptr;
+
+    if(!_segment.openSharedReadOnly(name)) return false;
+
+    auto header = reinterpret_cast<const StateMirror::Header*>(_segment.getData());
+
+    if(_segment.getSize() < sizeof(StateMirror::Header)
+       || header->magic.load(std::memory_order_acquire) != StateMirror::MAGIC) {
+        return false;
+    }
+
+    std::size_t wordsCount = (header->heatersNum + HEAT_STATE_WORD_BITS - 1) / HEAT_STATE_WORD_BITS;
+
+    if(header->version != StateMirror::VERSION || header->wordsCount != wordsCount
+       || StateMirror::_segmentSize(header->heatersNum, wordsCount) > _segment.getSize()) {
+        return false;
+    }
+
+    _header = header;
+
+    return true;
+}
+
+bool StateMirrorReader::isOpen() const {
+    return _header != nullptr;
+}
+
+HeaterNum StateMirrorReader::getHeatersCount() const {
+    return _header ? _header->heatersNum : 0;
+}
+
+bool StateMirrorReader::read(StateMirrorSnapshot& snapshot) const {
+    if(!_header) return false;
+
+    const unsigned char* powers = _segment.getData() + StateMirror::_powersOffset();
+    auto lastStates = reinterpret_cast<const HeatStateWord*>(
+            _segment.getData() + StateMirror::_statesOffset(_header->heatersNum));
+
+    snapshot.powers.resize(_header->heatersNum);
+    snapshot.lastStates.resize(_header->wordsCount);
+
+    return _header->seqLock.tryRead([&]() {
+        std::copy(powers, powers + _header->heatersNum, snapshot.powers.begin());
+        std::copy(lastStates, lastStates + _header->wordsCount, snapshot.lastStates.begin());
+        snapshot.frame = static_cast<Frame>(_header->frame);
+        snapshot.historyEpoch = _header->historyEpoch;
+        snapshot.frames = _header->frames;
+    }, READ_ATTEMPTS);
+}
@@ -0,0 +1,210 @@
+#ifndef HEATERS_STATE_MIRROR_H
+#define HEATERS_STATE_MIRROR_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "variables_description.h"
+#include "heat_schedule.h"
+#include "heat_sink.h"
+#include "mapped_file.h"
+#include "seq_lock.h"
+
+/**
+ * Снимок состояния модуля, прочитанный из разделяемой памяти
+ */
+struct StateMirrorSnapshot {
+    /**
+     * Текущие мощности нагревателей
+     */
+    std::vector<Power> powers;
+    /**
+     * Упакованные состояния нагревателей в прошлый полупериод (см. Heaters::getLastSemiPeriodState)
+     */
+    std::vector<HeatStateWord> lastStates;
+    /**
+     * Номер полупериода внутри секунды, который выполнит следующий zeroCrossed()
+     */
+    Frame frame = 0;
+    /**
+     * Голова истории мощностей - номер последней завершённой секунды (см. PowerHistory::getEpoch)
+     */
+    std::uint32_t historyEpoch = 0;
+    /**
+     * Количество опубликованных полупериодов: не меняется, если модуль остановлен
+     */
+    std::uint64_t frames = 0;
+
+    bool getLastSemiPeriodState(HeaterNum heater) const;
+};
+
+/**
+ * Зеркало состояния модуля в разделяемой памяти POSIX для внешних процессов мониторинга.
+ *
+ * Сегмент: заголовок с seqlock, мощности (по байту на нагреватель) и упакованные
+ * состояния прошлого полупериода. Писатель сегмента один - поток перехода через ноль (publishFrame):
+ * мощности, установленные из других потоков, копятся в буфере и попадают в сегмент при публикации.
+ * Писатель никогда не ждёт читателей, а любое количество читателей (StateMirrorReader)
+ * получает согласованные снимки без системных вызовов, повторяя чтение, если оно пересеклось с записью.
+ *
+ * @note Формат сегмента определяется VERSION: при любом его изменении версию нужно увеличить
+ */
+class StateMirror {
+public:
+    static const std::uint32_t MAGIC = 0x524d5348;
+    static const std::uint32_t VERSION = 1;
+
+    StateMirror() = default;
+
+    /**
+     * Удаляет имя сегмента
+     */
+    ~StateMirror();
+
+    StateMirror(const StateMirror&) = delete;
+    StateMirror& operator=(const StateMirror&) = delete;
+
+    /**
+     * Создаёт сегмент name (прежний сегмент с этим именем удаляется)
+     *
+     * @return false, если сегмент не удалось создать
+     */
+    bool open(const std::string& name, HeaterNum heatersNum);
+
+    /**
+     * Снимает отображение и удаляет имя сегмента
+     */
+    void close();
+
+    bool isOpen() const;
+
+    /**
+     * Запоминает мощность нагревателя (можно вызывать из любого потока):
+     * в сегмент она попадёт при следующем publishFrame()
+     */
+    void storePower(HeaterNum heater, Power power);
+
+    /**
+     * Запоминает мощности всех нагревателей схемы: в сегменте они появятся одной записью
+     * при следующем publishFrame()
+     */
+    void storePowers(const HeatSchedule& schedule);
+
+    /**
+     * Отмечает слово, исключённое из активных: в следующей публикации его состояния обнулятся
+     */
+    void retireWord(HeaterNum word);
+
+    /**
+     * Публикует состояния завершённого полупериода (states и changed - как в IHeatSink::setActiveStates)
+     * и мощности, запомненные с прошлой публикации
+     *
+     * @note Обновляются только активные слова и слова, отмеченные retireWord():
+     *       в остальных словах состояния нулевые и уже опубликованы.
+     *       Мощности копируются блоками по POWERS_BLOCK нагревателей, изменёнными с прошлой публикации
+     */
+    void publishFrame(const HeatStateWord* states, const HeatStateWord* changed,
+                      const HeaterNum* activeWords, std::size_t activeCount,
+                      Frame frame, std::uint32_t historyEpoch);
+
+private:
+    friend class StateMirrorReader;
+
+    /**
+     * Количество нагревателей в блоке мощностей с общим признаком изменения
+     */
+    static const HeaterNum POWERS_BLOCK = 64;
+
+    struct Header {
+        /**
+         * Записывается последним (store-release): читатель принимает сегмент после её чтения (load-acquire)
+         */
+        std::atomic<std::uint32_t> magic;
+        std::uint32_t version;
+        std::uint32_t heatersNum;
+        std::uint32_t wordsCount;
+        SeqLock seqLock;
+        std::uint32_t frame;
+        std::uint32_t historyEpoch;
+        std::uint64_t frames;
+    };
+
+    static_assert(ATOMIC_INT_LOCK_FREE == 2, "seqlock of shared memory must be lock-free");
+
+    /**
+     * Смещения мощностей и состояний от начала сегмента
+     */
+    static std::size_t _powersOffset();
+
+    static std::size_t _statesOffset(HeaterNum heatersNum);
+
+    static std::size_t _segmentSize(HeaterNum heatersNum, std::size_t wordsCount);
+
+    /**
+     * Отмечает блок мощностей нагревателя изменённым
+     */
+    void _markPower(HeaterNum heater);
+
+    /**
+     * Копирует в сегмент изменённые блоки мощностей (внутри записи seqlock)
+     */
+    void _flushPowers();
+
+private:
+    MappedFile _segment;
+    std::string _name;
+    Header* _header = nullptr;
+    unsigned char* _powers = nullptr;
+    HeatStateWord* _lastStates = nullptr;
+    /**
+     * Мощности, ещё не скопированные в сегмент, и признаки изменённых блоков (бит на блок POWERS_BLOCK)
+     */
+    std::vector<std::atomic<unsigned char>> _pendingPowers;
+    std::vector<std::atomic<std::uint64_t>> _changedBlocks;
+    /**
+     * Слова, исключённые из активных с прошлой публикации (память выделяется в open)
+     */
+    std::vector<HeaterNum> _retiredWords;
+    std::vector<unsigned char> _isRetired;
+};
+
+/**
+ * Читатель зеркала состояния (может работать в другом процессе)
+ */
+class StateMirrorReader {
+public:
+    /**
+     * Отображает сегмент name только для чтения
+     *
+     * @return false, если сегмента нет, он ещё не заполнен или его формат несовместим
+     */
+    bool open(const std::string& name);
+
+    bool isOpen() const;
+
+    HeaterNum getHeatersCount() const;
+
+    /**
+     * Читает согласованный снимок без системных вызовов
+     *
+     * @note Память снимка выделяется только при первом чтении
+     *
+     * @return false, если сегмент не открыт или за READ_ATTEMPTS попыток не удалось прочитать
+     *         согласованный снимок (например, писатель завершился посреди записи)
+     */
+    bool read(StateMirrorSnapshot& snapshot) const;
+
+    /**
+     * Наибольшее количество попыток чтения снимка
+     */
+    static const unsigned READ_ATTEMPTS = 10000;
+
+private:
+    MappedFile _segment;
+    const StateMirror::Header* _header = nullptr;
+};
+
+#endif //HEATERS_STATE_MIRROR_H
@@ -0,0 +1,426 @@
+#ifndef HEATERS_STATIC_HEATERS_H
+#define HEATERS_STATIC_HEATERS_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include "variables_description.h"
+#include "bit_operations.h"
+#include "heat_chains.h"
+#include "heat_sink.h"
+#include "iheaters.h"
+
+/**
+ * Схема нагревания на 1 секунду с размерами, известными на этапе компиляции.
+ *
+ * Раскладка и алгоритм инкрементального обновления общие с HeatSchedule (HeatChains),
+ * но все данные лежат в std::array внутри объекта, а размеры схемы - константы.
+ *
+ * @note Мощность задаётся в кадрах (от нуля до FrameCount)
+ */
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout = ScheduleLayout::SEQUENTIAL>
+class StaticHeatSchedule {
+public:
+    static constexpr HeaterNum WORDS_PER_FRAME = (HeatersNum + HEAT_FRAME_WORD_BITS - 1) / HEAT_FRAME_WORD_BITS;
+
+    /**
+     * Устанавливает мощность нагревателя и обновляет схему
+     */
+    void setPower(HeaterNum heater, Power frames);
+
+    /**
+     * Устанавливает мощность нагревателя без обновления схемы
+     *
+     * @note После установки всех мощностей необходимо вызвать rebuild()
+     */
+    void assignPower(HeaterNum heater, Power frames);
+
+    /**
+     * Полностью перестраивает схему по текущим мощностям
+     */
+    void rebuild();
+
+    Power getPower(HeaterNum heater) const;
+
+    bool isHeating(HeaterNum heater, Frame frame) const;
+
+    const HeatFrameWord* getFrameWords(Frame frame) const;
+
+    /**
+     * @return first - четные, second - нечётные
+     */
+    std::pair<HeaterNum, HeaterNum> getMaximumEvenOddHeaters() const;
+
+    /**
+     * @return first - четные, second - нечётные
+     */
+    std::pair<HeaterNum, HeaterNum> getMaximumEvenOddHeatersAfterPowerChange(HeaterNum heater, Power frames) const;
+
+private:
+    static constexpr HeaterNum CHAIN_STEP = Layout == ScheduleLayout::BALANCED ? 2 : 1;
+
+    static_assert(FrameCount <= HeatChains::MAX_FRAME_COUNT, "too many frames per second");
+
+    static HeatChains _chains();
+
+private:
+    std::array<Power, HeatersNum> _powers{};
+    std::array<Frame, HeatersNum> _starts{};
+    std::array<HeaterNum, FrameCount> _evenHeatersCounts{};
+    std::array<HeaterNum, FrameCount> _oddHeatersCounts{};
+    std::array<HeatFrameWord, FrameCount * WORDS_PER_FRAME> _frameWords{};
+};
+
+/**
+ * Функция установки состояния нагревателя без выделения памяти:
+ * вместо захваченных переменных получает context, переданный вместе с ней
+ */
+typedef void (*StaticHeatSetter)(void* context, HeaterNum heater, bool state);
+
+/**
+ * Вариант Heaters для встраиваемых систем с фиксированным количеством нагревателей
+ * и частотой сети: не использует динамическую память.
+ *
+ * @tparam HeatersNum - количество нагревателей
+ *
+ * @tparam FrameCount - количество полупериодов в 1 секунде (100 для 50Гц, 120 для 60Гц)
+ *
+ * @tparam Layout - способ раскладки нагревателей по полупериодам
+ *
+ * @note Мощность по-прежнему задаётся и возвращается в процентах, в полупериоды
+ *       она переводится с округлением до ближайшего целого.
+ *       Объект содержит всю историю мощностей, поэтому его следует размещать статически.
+ */
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout = ScheduleLayout::SEQUENTIAL>
+class StaticHeaters : public IHeaters {
+public:
+    /**
+     * @param sink - приёмник упакованных состояний нагревателей
+     */
+    explicit StaticHeaters(IHeatSink& sink);
+
+    /**
+     * @param setHeaterStateFn - функция для установки состояния нагревателя
+     * 		  (вызывается каждый полупериод для каждого нагревателя)
+     *
+     * @param context - первый аргумент setHeaterStateFn
+     */
+    StaticHeaters(StaticHeatSetter setHeaterStateFn, void* context);
+
+    /**
+     * @param setHeaterState - функция или функциональный объект setHeaterState(heater, state),
+     * 		  вызывается каждый полупериод для каждого нагревателя
+     *
+     * @note Объект не копируется и должен существовать, пока существует StaticHeaters
+     */
+    template<typename Setter, typename = typename std::enable_if<!std::is_base_of<IHeatSink, Setter>::value>::type>
+    explicit StaticHeaters(Setter& setHeaterState);
+
+    void setPower(HeaterNum heater, Power power) override;
+
+    bool setPowers(const HeaterPowers& powers, PowersCommit commit = PowersCommit::NEXT_FRAME) override;
+
+    void getMaxNumOfTurnedHeatersAfterPowerChange(HeaterNum heater, Power power,
+                                                  unsigned int& top, unsigned int& bot) override;
+
+    Power getPower(HeaterNum heater, unsigned short timeOffset = 0) override;
+
+    bool getLastSemiPeriodState(HeaterNum heaterNum) override;
+
+    void zeroCrossed();
+
+private:
+    static constexpr HeaterNum STATE_WORDS = (HeatersNum + HEAT_STATE_WORD_BITS - 1) / HEAT_STATE_WORD_BITS;
+
+    /**
+     * Переводит мощность в процентах в количество полупериодов
+     */
+    static Power _toFrames(Power power);
+
+    /**
+     * Переводит количество полупериодов в мощность в процентах
+     */
+    static Power _toPercent(Power frames);
+
+    template<typename Setter>
+    static void _callSetter(void* setter, HeaterNum heater, bool state);
+
+    void _commitPendingSchedule();
+
+    void _heating();
+
+    void _update();
+
+private:
+    IHeatSink* _sink = nullptr;
+    StaticHeatSetter _setHeaterState = nullptr;
+    void* _setterContext = nullptr;
+
+    StaticHeatSchedule<HeatersNum, FrameCount, Layout> _schedule;
+    StaticHeatSchedule<HeatersNum, FrameCount, Layout> _pendingSchedule;
+    bool _hasPendingSchedule = false;
+    PowersCommit _pendingCommit = PowersCommit::NEXT_FRAME;
+
+    std::array<HeatStateWord, STATE_WORDS> _states{};
+    std::array<HeatStateWord, STATE_WORDS> _changedStates{};
+    /**
+     * Количество включений каждого нагревателя в текущей секунде
+     */
+    std::array<unsigned char, HeatersNum> _turnOnCounts{};
+
+    /**
+     * История мощностей: столбец на секунду, как в PowerHistory
+     */
+    std::array<unsigned char, POWER_HISTORY_SECONDS * HeatersNum> _log{};
+    unsigned short _head = 0;
+
+    Frame _currentFrame = 0;
+};
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeatSchedule<HeatersNum, FrameCount, Layout>::setPower(HeaterNum heater, Power frames) {
+    _chains().setPower(_powers.data(), _starts.data(), _frameWords.data(), heater, frames,
+                       [this](HeaterNum changed, Frame from, Power count, bool add) {
+        std::array<HeaterNum, FrameCount>& counts = changed % 2 == 0 ? _evenHeatersCounts : _oddHeatersCounts;
+        Frame frame = from;
+
+        for(Power i = 0; i < count; ++i) {
+            if(add) {
+                ++counts[frame];
+            } else {
+                --counts[frame];
+            }
+
+            if(++frame >= FrameCount) frame = 0;
+        }
+    });
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeatSchedule<HeatersNum, FrameCount, Layout>::assignPower(HeaterNum heater, Power frames) {
+    _powers[heater] = frames;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeatSchedule<HeatersNum, FrameCount, Layout>::rebuild() {
+    _chains().layout(_powers.data(), _starts.data(), _frameWords.data());
+
+    for(Frame frame = 0; frame < FrameCount; ++frame) {
+        const HeatFrameWord* words = getFrameWords(frame);
+        HeaterNum even = 0;
+        HeaterNum odd = 0;
+
+        for(HeaterNum word = 0; word < WORDS_PER_FRAME; ++word) {
+            even += popCount(words[word] & EVEN_HEATERS_MASK);
+            odd += popCount(words[word] & ODD_HEATERS_MASK);
+        }
+
+        _evenHeatersCounts[frame] = even;
+        _oddHeatersCounts[frame] = odd;
+    }
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+Power StaticHeatSchedule<HeatersNum, FrameCount, Layout>::getPower(HeaterNum heater) const {
+    return _powers[heater];
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+bool StaticHeatSchedule<HeatersNum, FrameCount, Layout>::isHeating(HeaterNum heater, Frame frame) const {
+    HeatFrameWord word = getFrameWords(frame)[heater / HEAT_FRAME_WORD_BITS];
+
+    return (word >> (heater % HEAT_FRAME_WORD_BITS)) & 1u;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+const HeatFrameWord* StaticHeatSchedule<HeatersNum, FrameCount, Layout>::getFrameWords(Frame frame) const {
+    return _frameWords.data() + static_cast<std::size_t>(frame) * WORDS_PER_FRAME;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+std::pair<HeaterNum, HeaterNum> StaticHeatSchedule<HeatersNum, FrameCount, Layout>::getMaximumEvenOddHeaters() const {
+    return {*std::max_element(_evenHeatersCounts.begin(), _evenHeatersCounts.end()),
+            *std::max_element(_oddHeatersCounts.begin(), _oddHeatersCounts.end())};
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+std::pair<HeaterNum, HeaterNum> StaticHeatSchedule<HeatersNum, FrameCount, Layout>::getMaximumEvenOddHeatersAfterPowerChange(
+        HeaterNum heater, Power frames) const {
+    return _chains().getPeaksAfterChange(_powers.data(), _starts.data(), heater, frames, [this](Frame frame) {
+        return std::make_pair(_evenHeatersCounts[frame], _oddHeatersCounts[frame]);
+    });
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+HeatChains StaticHeatSchedule<HeatersNum, FrameCount, Layout>::_chains() {
+    return HeatChains(HeatersNum, FrameCount, CHAIN_STEP, WORDS_PER_FRAME);
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+StaticHeaters<HeatersNum, FrameCount, Layout>::StaticHeaters(IHeatSink& sink) : _sink(&sink) {
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+StaticHeaters<HeatersNum, FrameCount, Layout>::StaticHeaters(StaticHeatSetter setHeaterStateFn, void* context)
+        : _setHeaterState(setHeaterStateFn), _setterContext(context) {
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+template<typename Setter, typename>
+StaticHeaters<HeatersNum, FrameCount, Layout>::StaticHeaters(Setter& setHeaterState)
+        : _setHeaterState(&_callSetter<Setter>),
+          _setterContext(const_cast<void*>(static_cast<const void*>(&setHeaterState))) {
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::setPower(HeaterNum heater, Power power) {
+    if(heater >= HeatersNum || power > MAXIMUM_HEATER_POWER) return;
+
+    _schedule.setPower(heater, _toFrames(power));
+
+    if(_hasPendingSchedule) {
+        _pendingSchedule.setPower(heater, _toFrames(power));
+    }
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+bool StaticHeaters<HeatersNum, FrameCount, Layout>::setPowers(const HeaterPowers& powers, PowersCommit commit) {
+    for(const auto& heaterAndPower: powers) {
+        if(heaterAndPower.first >= HeatersNum || heaterAndPower.second > MAXIMUM_HEATER_POWER) {
+            return false;
+        }
+    }
+
+    if(!_hasPendingSchedule) {
+        _pendingSchedule = _schedule;
+    }
+
+    for(const auto& heaterAndPower: powers) {
+        _pendingSchedule.assignPower(heaterAndPower.first, _toFrames(heaterAndPower.second));
+    }
+
+    _pendingSchedule.rebuild();
+    _hasPendingSchedule = true;
+    _pendingCommit = commit;
+
+    return true;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::getMaxNumOfTurnedHeatersAfterPowerChange(
+        HeaterNum heater, Power power, unsigned int& top, unsigned int& bot) {
+    std::pair<HeaterNum, HeaterNum> evenOddHeaters;
+
+    if(heater >= HeatersNum || power > MAXIMUM_HEATER_POWER) {
+        evenOddHeaters = _schedule.getMaximumEvenOddHeaters();
+    } else {
+        evenOddHeaters = _schedule.getMaximumEvenOddHeatersAfterPowerChange(heater, _toFrames(power));
+    }
+
+    top = evenOddHeaters.first;
+    bot = evenOddHeaters.second;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+Power StaticHeaters<HeatersNum, FrameCount, Layout>::getPower(HeaterNum heater, unsigned short timeOffset) {
+    if(heater >= HeatersNum || timeOffset >= POWER_HISTORY_SECONDS) return 0;
+
+    unsigned short second = (_head + POWER_HISTORY_SECONDS - timeOffset) % POWER_HISTORY_SECONDS;
+
+    return _toPercent(_log[static_cast<std::size_t>(second) * HeatersNum + heater]);
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+bool StaticHeaters<HeatersNum, FrameCount, Layout>::getLastSemiPeriodState(HeaterNum heaterNum) {
+    if(heaterNum >= HeatersNum) return false;
+
+    HeaterNum word = heaterNum / HEAT_STATE_WORD_BITS;
+    HeatStateWord lastStates = _states[word] ^ _changedStates[word];
+
+    return (lastStates >> (heaterNum % HEAT_STATE_WORD_BITS)) & 1u;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::zeroCrossed() {
+    _commitPendingSchedule();
+
+    _heating();
+
+    if(++_currentFrame == FrameCount) {
+        _currentFrame = 0;
+        _update();
+    }
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+Power StaticHeaters<HeatersNum, FrameCount, Layout>::_toFrames(Power power) {
+    return (power * FrameCount + MAXIMUM_HEATER_POWER / 2) / MAXIMUM_HEATER_POWER;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+Power StaticHeaters<HeatersNum, FrameCount, Layout>::_toPercent(Power frames) {
+    return (frames * MAXIMUM_HEATER_POWER + FrameCount / 2) / FrameCount;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+template<typename Setter>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::_callSetter(void* setter, HeaterNum heater, bool state) {
+    (*static_cast<Setter*>(setter))(heater, state);
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::_commitPendingSchedule() {
+    if(!_hasPendingSchedule) return;
+
+    if(_pendingCommit == PowersCommit::NEXT_SECOND && _currentFrame != 0) return;
+
+    _schedule = _pendingSchedule;
+    _hasPendingSchedule = false;
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::_heating() {
+    const HeatFrameWord* frameWords = _schedule.getFrameWords(_currentFrame);
+    const HeaterNum stateWordsPerFrameWord = HEAT_FRAME_WORD_BITS / HEAT_STATE_WORD_BITS;
+
+    for(HeaterNum word = 0; word < STATE_WORDS; ++word) {
+        HeatFrameWord frameWord = frameWords[word / stateWordsPerFrameWord];
+        HeatStateWord states = static_cast<HeatStateWord>(
+                frameWord >> (word % stateWordsPerFrameWord * HEAT_STATE_WORD_BITS));
+
+        _changedStates[word] = _states[word] ^ states;
+        _states[word] = states;
+
+        HeaterNum first = word * HEAT_STATE_WORD_BITS;
+
+        while(states) {
+            ++_turnOnCounts[first + countTrailingZeros(states)];
+            states &= states - 1;
+        }
+    }
+
+    if(_sink) {
+        _sink->setStates(_states.data(), _changedStates.data(), STATE_WORDS);
+    } else if(_setHeaterState) {
+        for(HeaterNum heaterNum = 0; heaterNum < HeatersNum; ++heaterNum) {
+            HeatStateWord word = _states[heaterNum / HEAT_STATE_WORD_BITS];
+
+            _setHeaterState(_setterContext, heaterNum, (word >> (heaterNum % HEAT_STATE_WORD_BITS)) & 1u);
+        }
+    }
+}
+
+template<HeaterNum HeatersNum, Frame FrameCount, ScheduleLayout Layout>
+void StaticHeaters<HeatersNum, FrameCount, Layout>::_update() {
+    if(++_head >= POWER_HISTORY_SECONDS) _head = 0;
+
+    std::copy(_turnOnCounts.begin(), _turnOnCounts.end(),
+              _log.begin() + static_cast<std::ptrdiff_t>(_head) * HeatersNum);
+
+    _turnOnCounts.fill(0);
+}
+
+#endif //HEATERS_STATIC_HEATERS_H
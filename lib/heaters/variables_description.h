@@ -1,8 +1,27 @@
 #ifndef HEATERS_VARIABLES_DESCRIPTION_H
 #define HEATERS_VARIABLES_DESCRIPTION_H
 
+#include <utility>
+#include <vector>
+
 typedef unsigned int HeaterNum;
 typedef unsigned int Power;
 typedef unsigned short Frame;
+typedef unsigned short GroupNum;
+
+/**
+ * Набор пар (номер нагревателя, мощность)
+ */
+typedef std::vector<std::pair<HeaterNum, Power>> HeaterPowers;
+
+/**
+ * Максимально возможная мощность нагревателя в процентах
+ */
+static const Power MAXIMUM_HEATER_POWER = 100;
+
+/**
+ * Глубина истории мощностей нагревателя в секундах (10 минут)
+ */
+static const unsigned short POWER_HISTORY_SECONDS = 600;
 
 #endif //HEATERS_VARIABLES_DESCRIPTION_H
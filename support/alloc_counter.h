@@ -0,0 +1,18 @@
+#ifndef HEATERS_ALLOC_COUNTER_H
+#define HEATERS_ALLOC_COUNTER_H
+
+#include <cstddef>
+
+/**
+ * Счётчик обращений к глобальному распределителю памяти.
+ *
+ * alloc_counter.cpp заменяет глобальные operator new и operator delete;
+ * подключается к тестам и бенчмарку, чтобы проверять горячие пути на отсутствие выделений памяти.
+ */
+
+/**
+ * Количество вызовов operator new с начала работы программы
+ */
+std::size_t getAllocationsCount();
+
+#endif //HEATERS_ALLOC_COUNTER_H
@@ -1,11 +1,73 @@
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "bit_operations.h"
 #include "heaters.h"
+#include "concurrent_heaters.h"
+#include "event_recorder.h"
+#include "heat_schedule.h"
+#include "heater_zones.h"
+#include "power_history.h"
+#include "recording_heaters.h"
+#include "state_mirror.h"
+#include "static_heaters.h"
+#include "alloc_counter.h"
+
+/**
+ * Реализации IHeaters, на которых проходят базовые тесты модуля:
+ * Type<N> - модуль на N нагревателей с функцией установки состояния
+ */
+struct DynamicHeaters {
+    template<HeaterNum HeatersNum>
+    class Type : public Heaters {
+    public:
+        explicit Type(const HeatSetter& setter) : Heaters(HeatersNum, setter) {
+        }
+    };
+};
+
+struct FixedHeaters {
+    template<HeaterNum HeatersNum>
+    using Type = StaticHeaters<HeatersNum, 100>;
+};
+
+typedef ::testing::Types<DynamicHeaters, FixedHeaters> HeatersImplementations;
+
+template<typename Implementation>
+class SetPower : public ::testing::Test {
+};
+
+template<typename Implementation>
+class GetPower : public ::testing::Test {
+};
+
+template<typename Implementation>
+class getLastSemiPeriodState : public ::testing::Test {
+};
+
+template<typename Implementation>
+class getMaxNumOfTurnedHeatersAfterPowerChange : public ::testing::Test {
+};
+
+TYPED_TEST_SUITE(SetPower, HeatersImplementations);
+TYPED_TEST_SUITE(GetPower, HeatersImplementations);
+TYPED_TEST_SUITE(getLastSemiPeriodState, HeatersImplementations);
+TYPED_TEST_SUITE(getMaxNumOfTurnedHeatersAfterPowerChange, HeatersImplementations);
 
 /**
  * Ничего не изменяет, если мощность больше 100
  */
-TEST(SetPower, does_not_change_if_power_101) {
+TYPED_TEST(SetPower, does_not_change_if_power_101) {
     bool heater_state = false;
     short heater_num = -1;
 
@@ -14,7 +76,7 @@ TEST(SetPower, does_not_change_if_power_101) {
         heater_num = num;
     };
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     heaters.setPower(0, 101);
 
@@ -33,7 +95,7 @@ TEST(SetPower, does_not_change_if_power_101) {
 /**
  * Установленная мощность не изменяется с течением времени
  */
-TEST(SetPower, power_stays_same_if_new_power_was_not_set) {
+TYPED_TEST(SetPower, power_stays_same_if_new_power_was_not_set) {
     bool heater_state = false;
     short heater_num = -1;
 
@@ -42,7 +104,7 @@ TEST(SetPower, power_stays_same_if_new_power_was_not_set) {
         heater_num = num;
     };
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     // Продержать мощность 24 в течение секунды
     heaters.setPower(0, 24);
@@ -65,7 +127,7 @@ TEST(SetPower, power_stays_same_if_new_power_was_not_set) {
 /**
  * Мощность должна изменятся в течение секунды
  */
-TEST(SetPower, change_during_second) {
+TYPED_TEST(SetPower, change_during_second) {
     bool heater_state = false;
     short heater_num = -1;
 
@@ -74,7 +136,7 @@ TEST(SetPower, change_during_second) {
         heater_num = num;
     };
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     for (int i = 0; i < 20; ++i) {
         heaters.zeroCrossed();
@@ -93,10 +155,10 @@ TEST(SetPower, change_during_second) {
  * Для нагревателя, номер которого больше либо равен числу нагревателей
  * (отсчёт от нуля), возвращает нулевую мощность
  */
-TEST(GetPower, returns_0_if_heaters_num_GE_than_heatersNum) {
+TYPED_TEST(GetPower, returns_0_if_heaters_num_GE_than_heatersNum) {
     auto setter = [](int, bool) {};
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     ASSERT_EQ(heaters.getPower(100), 0);
 }
@@ -105,7 +167,7 @@ TEST(GetPower, returns_0_if_heaters_num_GE_than_heatersNum) {
 /**
  * Устанавливает заданную мощность на нагреватель
  */
-TEST(SetPower, power_42_heater_is_on_42_times_within_100_semi_periods) {
+TYPED_TEST(SetPower, power_42_heater_is_on_42_times_within_100_semi_periods) {
     bool heater_state = false;
     short heater_num = -1;
 
@@ -114,7 +176,7 @@ TEST(SetPower, power_42_heater_is_on_42_times_within_100_semi_periods) {
         heater_num = num;
     };
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     heaters.setPower(0, 42);
 
@@ -135,9 +197,9 @@ TEST(SetPower, power_42_heater_is_on_42_times_within_100_semi_periods) {
  * Возвращает мощность за последнюю законченную секунду
  * (т.е. не учитывает мощности текущей незавершённой секунды)
  */
-TEST(GetPower, without_offset_returns_last_second_power) {
+TYPED_TEST(GetPower, without_offset_returns_last_second_power) {
     auto setter = [](int, bool) {};
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     // Устанавливаем мощность ожидаем 1 с
     heaters.setPower(0, 10);
@@ -160,10 +222,10 @@ TEST(GetPower, without_offset_returns_last_second_power) {
 /**
  * Если оффсет больше числа прошедших полупериодов, возвращает нулевую мощность
  */
-TEST(GetPower, returns_0_if_offset_G_than_amount_of_zeroCrossed_calls) {
+TYPED_TEST(GetPower, returns_0_if_offset_G_than_amount_of_zeroCrossed_calls) {
     auto setter = [](int, bool) {};
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
     heaters.setPower(0, 100);
 
     for(int i = 0; i < 2 * 100; ++i) {
@@ -178,7 +240,7 @@ TEST(GetPower, returns_0_if_offset_G_than_amount_of_zeroCrossed_calls) {
  * Если мощность менялась в течение секунды, возвращается округлённая средняя
  * мощность
  */
-TEST(GetPower, returns_rounded_mean_if_power_changed_within_second) {
+TYPED_TEST(GetPower, returns_rounded_mean_if_power_changed_within_second) {
     bool heater_state = false;
     short heater_num = -1;
 
@@ -187,7 +249,7 @@ TEST(GetPower, returns_rounded_mean_if_power_changed_within_second) {
         heater_num = num;
     };
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
     Power p = 0;
 
     heaters.setPower(0, 10);
@@ -222,10 +284,10 @@ TEST(GetPower, returns_rounded_mean_if_power_changed_within_second) {
 /**
  * Хранит историю установленных мощностей за последние 10 минут
  */
-TEST(GetPower, keeps_history_of_last_10_minuets_powers) {
+TYPED_TEST(GetPower, keeps_history_of_last_10_minuets_powers) {
     auto setter = [](int, bool) {};
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     heaters.setPower(0, 100);
 
@@ -244,11 +306,45 @@ TEST(GetPower, keeps_history_of_last_10_minuets_powers) {
 }
 
 
+/**
+ * Функция установки состояния вызывается каждый полупериод для каждого нагревателя,
+ * нагреватели без мощности получают выключение
+ */
+TYPED_TEST(SetPower, setter_is_called_for_every_heater_every_semi_period) {
+    const HeaterNum heatersNum = 70;
+    std::vector<int> calls(heatersNum, 0);
+    std::vector<int> turnOns(heatersNum, 0);
+
+    auto setter = [&calls, &turnOns](int num, bool state) {
+        ++calls[num];
+        turnOns[num] += state;
+    };
+
+    typename TypeParam::template Type<heatersNum> heaters(setter);
+
+    heaters.setPower(5, 30);
+
+    for(int i = 0; i < 150; ++i) {
+        heaters.zeroCrossed();
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            ASSERT_EQ(calls[heater], i + 1) << heater;
+        }
+
+        if(i == 99) heaters.setPower(5, 0);
+    }
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        ASSERT_EQ(turnOns[heater], heater == 5 ? 30 : 0) << heater;
+    }
+}
+
+
 /**
  * Возвращает то же состояние, которое установил на нагреватель в прошлый
  * полупериод
  */
-TEST(getLastSemiPeriodState, returns_state_set_power_called_with) {
+TYPED_TEST(getLastSemiPeriodState, returns_state_set_power_called_with) {
 
     bool heater_state = false;
     short heater_num = -1;
@@ -258,7 +354,7 @@ TEST(getLastSemiPeriodState, returns_state_set_power_called_with) {
         heater_num = num;
     };
 
-    Heaters heaters(1, setter);
+    typename TypeParam::template Type<1> heaters(setter);
 
     heaters.setPower(0, 28);
 
@@ -274,11 +370,11 @@ TEST(getLastSemiPeriodState, returns_state_set_power_called_with) {
 /**
  * Если суммарная мощность ноль, не работает ни один нагреватель
  */
-TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
+TYPED_TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
      set_power_0_returns_top_0_bot_0) {
     auto setter = [](int, bool) {};
 
-    Heaters heaters(42, setter);
+    typename TypeParam::template Type<42> heaters(setter);
 
     unsigned int top = 0;
     unsigned int bot = 0;
@@ -293,11 +389,11 @@ TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
 /**
  * Даже при минимальной мощности число включённых нагревателей увеличивается
  */
-TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
+TYPED_TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
      heaters_0_and_1_power_1_top_1_bot_1) {
     auto setter = [](int, bool) {};
 
-    Heaters heaters(42, setter);
+    typename TypeParam::template Type<42> heaters(setter);
     unsigned int top = 0;
     unsigned int bot = 0;
 
@@ -312,11 +408,11 @@ TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
 /**
  * Учитывает умное управление
  */
-TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
+TYPED_TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
      _9_heaters_with_power_10_ask_power_10_to_10th_returns_top_1_bot_0) {
     auto setter = [](int, bool) {};
 
-    Heaters heaters(40, setter);
+    typename TypeParam::template Type<40> heaters(setter);
 
     unsigned int top = 0;
     unsigned int bot = 0;
@@ -336,4 +432,1595 @@ TEST(getMaxNumOfTurnedHeatersAfterPowerChange,
 
     ASSERT_EQ(top, 1);
     ASSERT_EQ(bot, 0);
-}
\ No newline at end of file
+}
+
+/**
+ * Инкрементальное обновление схемы даёт ту же раскладку,
+ * что и полное перестроение "по кругу" в порядке номеров нагревателей
+ */
+TEST(HeatSchedule, incremental_update_matches_full_rebuild) {
+    const HeaterNum heatersNum = 37;
+    const Frame frameCount = 100;
+
+    HeatSchedule schedule(heatersNum, frameCount);
+    std::vector<Power> powers(heatersNum, 0);
+
+    std::srand(42);
+    for(int step = 0; step < 500; ++step) {
+        HeaterNum heater = std::rand() % heatersNum;
+        Power power = std::rand() % 101;
+
+        powers[heater] = power;
+        schedule.setPower(heater, power);
+
+        // Полное перестроение схемы
+        std::vector<std::vector<bool>> expected(frameCount, std::vector<bool>(heatersNum, false));
+        Frame frame = 0;
+        for(HeaterNum num = 0; num < heatersNum; ++num) {
+            for(Power p = 0; p < powers[num]; ++p) {
+                expected[frame][num] = true;
+                if(++frame >= frameCount) frame = 0;
+            }
+        }
+
+        for(Frame f = 0; f < frameCount; ++f) {
+            HeaterNum even = 0;
+            HeaterNum odd = 0;
+
+            for(HeaterNum num = 0; num < heatersNum; ++num) {
+                ASSERT_EQ(schedule.isHeating(num, f), expected[f][num]);
+
+                if(expected[f][num]) {
+                    if(num % 2 == 0) ++even; else ++odd;
+                }
+            }
+
+            ASSERT_EQ(schedule.getFrame(f).getEvenHeatersCount(), even);
+            ASSERT_EQ(schedule.getFrame(f).getOddHeatersCount(), odd);
+        }
+    }
+}
+
+
+/**
+ * Оценка пиков после изменения мощности совпадает с пиками
+ * после реального изменения и не изменяет схему
+ */
+TEST(HeatSchedule, peaks_after_power_change_match_applied_change) {
+    const HeaterNum heatersNum = 25;
+
+    HeatSchedule schedule(heatersNum, 100);
+
+    std::srand(7);
+    for(HeaterNum num = 0; num < heatersNum; ++num) {
+        schedule.setPower(num, std::rand() % 101);
+    }
+
+    for(int step = 0; step < 300; ++step) {
+        HeaterNum heater = std::rand() % heatersNum;
+        Power power = std::rand() % 101;
+        Power oldPower = schedule.getPower(heater);
+
+        auto before = schedule.getMaximumEvenOddHeaters();
+        auto predicted = schedule.getMaximumEvenOddHeatersAfterPowerChange(heater, power);
+
+        ASSERT_EQ(schedule.getMaximumEvenOddHeaters(), before);
+
+        schedule.setPower(heater, power);
+        ASSERT_EQ(schedule.getMaximumEvenOddHeaters(), predicted);
+
+        schedule.setPower(heater, oldPower);
+        ASSERT_EQ(schedule.getMaximumEvenOddHeaters(), before);
+    }
+}
+
+
+/**
+ * Набор мощностей вступает в силу целиком с начала следующей секунды
+ */
+TEST(SetPowers, batch_takes_effect_at_next_second) {
+    std::vector<bool> states(3, false);
+
+    auto setter = [&states](int num, bool state) {
+        states[num] = state;
+    };
+
+    Heaters heaters(3, setter);
+
+    for(int i = 0; i < 50; ++i) {
+        heaters.zeroCrossed();
+    }
+
+    ASSERT_TRUE(heaters.setPowers({{0, 100}, {1, 100}, {2, 30}}, PowersCommit::NEXT_SECOND));
+
+    // До конца текущей секунды нагреватели не включаются
+    for(int i = 0; i < 50; ++i) {
+        heaters.zeroCrossed();
+        ASSERT_FALSE(states[0]);
+        ASSERT_FALSE(states[1]);
+        ASSERT_FALSE(states[2]);
+    }
+
+    Power p = 0;
+    for(int i = 0; i < 100; ++i) {
+        heaters.zeroCrossed();
+        ASSERT_TRUE(states[0]);
+        ASSERT_TRUE(states[1]);
+        if(states[2]) {
+            ++p;
+        }
+    }
+
+    ASSERT_EQ(p, 30);
+    ASSERT_EQ(heaters.getPower(1), 100);
+}
+
+
+/**
+ * Набор с некорректной мощностью или номером нагревателя не применяется целиком
+ */
+TEST(SetPowers, rejects_whole_batch_if_any_entry_is_invalid) {
+    bool heater_state = false;
+
+    auto setter = [&heater_state](int num, bool state) {
+        if(num == 0) heater_state = state;
+    };
+
+    Heaters heaters(2, setter);
+
+    ASSERT_FALSE(heaters.setPowers({{0, 50}, {1, 101}}));
+    ASSERT_FALSE(heaters.setPowers({{0, 50}, {2, 10}}));
+
+    for(int i = 0; i < 100; ++i) {
+        heaters.zeroCrossed();
+        ASSERT_FALSE(heater_state);
+    }
+}
+
+
+/**
+ * История хранит мощности каждого нагревателя отдельно и вытесняет
+ * секунды старше TIME_LIMIT
+ */
+TEST(PowerHistory, keeps_separate_rings_for_heaters) {
+    PowerHistory history(3);
+
+    for(Power second = 0; second < PowerHistory::TIME_LIMIT + 10; ++second) {
+        history.roll();
+        history.record(0, second % 100);
+        history.record(1, 100 - second % 100);
+        history.record(2, 0);
+    }
+
+    Power last = PowerHistory::TIME_LIMIT + 9;
+
+    for(unsigned short offset = 0; offset < PowerHistory::TIME_LIMIT; ++offset) {
+        ASSERT_EQ(history.getPower(0, offset), (last - offset) % 100);
+        ASSERT_EQ(history.getPower(1, offset), 100 - (last - offset) % 100);
+        ASSERT_EQ(history.getPower(2, offset), 0);
+    }
+
+    ASSERT_EQ(history.getPower(0, PowerHistory::TIME_LIMIT), 0);
+}
+
+
+/**
+ * Приёмник получает упакованные состояния и маску изменившихся нагревателей
+ */
+TEST(HeatSink, receives_packed_states_and_changed_mask) {
+    struct RecordingSink : IHeatSink {
+        std::vector<HeatStateWord> states;
+        std::vector<HeatStateWord> changed;
+        int calls = 0;
+
+        void setStates(const HeatStateWord* newStates, const HeatStateWord* newChanged,
+                       std::size_t wordsCount) override {
+            states.assign(newStates, newStates + wordsCount);
+            changed.assign(newChanged, newChanged + wordsCount);
+            ++calls;
+        }
+    } sink;
+
+    Heaters heaters(40, sink);
+
+    heaters.setPower(0, 100);
+    heaters.setPower(33, 100);
+    heaters.setPower(35, 1);
+
+    heaters.zeroCrossed();
+
+    ASSERT_EQ(sink.calls, 1);
+    ASSERT_EQ(sink.states.size(), 2u);
+    ASSERT_EQ(sink.states[0], 1u);
+    ASSERT_EQ(sink.states[1], (1u << 1) | (1u << 3));
+    ASSERT_EQ(sink.changed[1], (1u << 1) | (1u << 3));
+
+    // Нагреватель 35 выключается, остальные не меняют состояние
+    heaters.zeroCrossed();
+
+    ASSERT_EQ(sink.calls, 2);
+    ASSERT_EQ(sink.states[0], 1u);
+    ASSERT_EQ(sink.states[1], 1u << 1);
+    ASSERT_EQ(sink.changed[0], 0u);
+    ASSERT_EQ(sink.changed[1], 1u << 3);
+}
+
+
+/**
+ * Приёмник получает только активные слова: с мощностью или с выключением,
+ * ещё не переданным приёмнику; остальные слова нулевые
+ */
+TEST(HeatSink, active_words_cover_powered_and_switched_off_heaters) {
+    struct ActiveSink : IHeatSink {
+        std::vector<HeatStateWord> states;
+        std::vector<HeatStateWord> changed;
+        std::vector<HeaterNum> active;
+
+        void setStates(const HeatStateWord*, const HeatStateWord*, std::size_t) override {
+            FAIL() << "Heaters passes active words";
+        }
+
+        void setActiveStates(const HeatStateWord* newStates, const HeatStateWord* newChanged, std::size_t wordsCount,
+                             const HeaterNum* activeWords, std::size_t activeCount) override {
+            states.assign(newStates, newStates + wordsCount);
+            changed.assign(newChanged, newChanged + wordsCount);
+            active.assign(activeWords, activeWords + activeCount);
+        }
+    } sink;
+
+    const HeaterNum heatersNum = 1000;
+    Heaters heaters(heatersNum, sink, ScheduleLayout::BALANCED);
+    std::vector<HeatStateWord> previous(sink.states.size());
+
+    std::srand(59);
+    for(int frame = 0; frame < 3000; ++frame) {
+        if(std::rand() % 8 == 0) {
+            // Мощность получают немногие нагреватели, остальные выключаются
+            heaters.setPower(std::rand() % heatersNum, std::rand() % 3 ? 0 : std::rand() % 101);
+        }
+
+        if(frame % 450 == 0) {
+            heaters.setPowers({{std::rand() % heatersNum, 60}, {std::rand() % heatersNum, 0}},
+                              frame % 900 ? PowersCommit::NEXT_FRAME : PowersCommit::NEXT_SECOND);
+        }
+
+        Frame current = heaters.getCurrentFrame();
+
+        heaters.zeroCrossed();
+        previous.resize(sink.states.size());
+
+        std::vector<bool> isActive(sink.states.size(), false);
+        HeaterNum turnedOn = 0;
+
+        for(HeaterNum word: sink.active) {
+            ASSERT_FALSE(isActive[word]) << "duplicate word " << word;
+            isActive[word] = true;
+        }
+
+        for(std::size_t word = 0; word < sink.states.size(); ++word) {
+            ASSERT_EQ(sink.changed[word], previous[word] ^ sink.states[word]) << frame << " " << word;
+
+            if(!isActive[word]) {
+                ASSERT_EQ(sink.states[word], 0u) << frame << " " << word;
+                ASSERT_EQ(sink.changed[word], 0u) << frame << " " << word;
+            }
+
+            turnedOn += popCount(sink.states[word]);
+        }
+
+        // Ни одно слово с включёнными нагревателями не пропущено
+        std::pair<HeaterNum, HeaterNum> expected = heaters.getTurnedHeaters(current);
+        ASSERT_EQ(turnedOn, expected.first + expected.second) << frame;
+
+        previous = sink.states;
+    }
+
+    // Без мощности активные слова выключаются и покидают список
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) heaters.setPower(heater, 0);
+
+    heaters.zeroCrossed();
+    heaters.zeroCrossed();
+
+    ASSERT_TRUE(sink.active.empty());
+}
+
+/**
+ * Перестроение схемы по битовым наборам даёт те же кадры и счётчики,
+ * что и инкрементальное обновление
+ */
+TEST(HeatSchedule, batch_peaks_match_single_queries) {
+    for(ScheduleLayout layout: {ScheduleLayout::SEQUENTIAL, ScheduleLayout::BALANCED}) {
+        const HeaterNum heatersNum = 45;
+        HeatSchedule schedule(heatersNum, 100, layout);
+
+        std::srand(37);
+        for(int change = 0; change < 200; ++change) {
+            schedule.setPower(std::rand() % heatersNum, std::rand() % 101);
+        }
+
+        HeaterPowers candidates;
+
+        for(int candidate = 0; candidate < 500; ++candidate) {
+            candidates.emplace_back(std::rand() % (heatersNum + 2), std::rand() % 103);
+        }
+
+        std::vector<std::pair<HeaterNum, HeaterNum>> peaks;
+        std::vector<std::size_t> order;
+        schedule.getMaximumEvenOddHeatersAfterPowerChanges(candidates, peaks, order);
+
+        ASSERT_EQ(peaks.size(), candidates.size());
+
+        for(std::size_t candidate = 0; candidate < candidates.size(); ++candidate) {
+            HeaterNum heater = candidates[candidate].first;
+            Power power = candidates[candidate].second;
+            auto expected = heater < heatersNum && power <= 100
+                            ? schedule.getMaximumEvenOddHeatersAfterPowerChange(heater, power)
+                            : schedule.getMaximumEvenOddHeaters();
+
+            ASSERT_EQ(peaks[candidate], expected) << heater << " " << power;
+        }
+    }
+}
+
+TEST(HeatSchedule, admissible_power_matches_brute_force) {
+    for(ScheduleLayout layout: {ScheduleLayout::SEQUENTIAL, ScheduleLayout::BALANCED}) {
+        const HeaterNum heatersNum = 30;
+        HeatSchedule schedule(heatersNum, 100, layout);
+
+        std::srand(41);
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            schedule.setPower(heater, std::rand() % 60);
+        }
+
+        for(int query = 0; query < 200; ++query) {
+            HeaterNum heater = std::rand() % heatersNum;
+            HeaterNum maxEven = std::rand() % 12;
+            HeaterNum maxOdd = std::rand() % 12;
+            Power limit = std::rand() % 101;
+            Power power = 0;
+            int expected = -1;
+
+            for(Power candidate = 0; candidate <= limit; ++candidate) {
+                HeatSchedule changed = schedule;
+
+                changed.setPower(heater, candidate);
+
+                auto peaks = changed.getMaximumEvenOddHeaters();
+
+                if(peaks.first <= maxEven && peaks.second <= maxOdd) expected = candidate;
+            }
+
+            bool found = schedule.getMaximumAdmissiblePower(heater, maxEven, maxOdd, power, limit);
+
+            ASSERT_EQ(found, expected >= 0);
+            if(found) {
+                ASSERT_EQ(power, static_cast<Power>(expected));
+            }
+        }
+    }
+}
+
+TEST(HeatSchedule, distributes_budget_within_peak_limits) {
+    HeatSchedule schedule(10, 100, ScheduleLayout::BALANCED);
+
+    schedule.setPower(0, 80);
+    schedule.setPower(1, 30);
+
+    std::vector<HeaterNum> heaters = {2, 3, 4, 5, 7};
+    HeaterPowers powers;
+
+    // Верхние: 80 уже занято, в пределе 2 остаётся 120; нижние: 30 занято, в пределе 1 остаётся 70
+    HeatSchedule applied = schedule;
+    std::uint32_t distributed = applied.distributePowerBudget(heaters, 1000, 2, 1, powers);
+
+    ASSERT_EQ(powers.size(), heaters.size());
+
+    std::uint32_t sum = 0;
+    std::uint32_t odd = 0;
+
+    for(const auto& heaterAndPower: powers) {
+        ASSERT_EQ(applied.getPower(heaterAndPower.first), heaterAndPower.second);
+        sum += heaterAndPower.second;
+        odd += heaterAndPower.first % 2 ? heaterAndPower.second : 0;
+    }
+
+    ASSERT_EQ(distributed, sum);
+    ASSERT_EQ(distributed, 190u);
+    ASSERT_EQ(odd, 70u);
+    ASSERT_LE(applied.getMaximumEvenOddHeaters().first, 2u);
+    ASSERT_LE(applied.getMaximumEvenOddHeaters().second, 1u);
+
+    // Небольшой бюджет делится поровну
+    schedule.distributePowerBudget(heaters, 50, 2, 1, powers);
+
+    for(const auto& heaterAndPower: powers) {
+        ASSERT_EQ(heaterAndPower.second, 10u);
+    }
+
+    // Повторный нагреватель получает мощность один раз, бюджет не превышается
+    std::vector<HeaterNum> repeated = {2, 3, 2, 4, 3, 2};
+
+    distributed = schedule.distributePowerBudget(repeated, 60, 2, 1, powers);
+
+    ASSERT_EQ(powers.size(), 3u);
+    ASSERT_EQ(distributed, 60u);
+
+    for(const auto& heaterAndPower: powers) {
+        ASSERT_EQ(heaterAndPower.second, 20u);
+        ASSERT_EQ(schedule.getPower(heaterAndPower.first), 20u);
+    }
+}
+
+/**
+ * Распределённые мощности укладываются в пределы пиков и бюджет на случайных схемах
+ */
+TEST(HeatSchedule, distributed_budget_respects_limits) {
+    std::srand(11);
+
+    for(ScheduleLayout layout: {ScheduleLayout::SEQUENTIAL, ScheduleLayout::BALANCED}) {
+        const HeaterNum heatersNum = 60;
+        HeatSchedule schedule(heatersNum, 100, layout);
+        HeaterPowers powers;
+
+        for(int round = 0; round < 20; ++round) {
+            std::vector<HeaterNum> heaters;
+            HeaterNum maxEven = 3 + std::rand() % 10;
+            HeaterNum maxOdd = 3 + std::rand() % 10;
+            std::uint32_t budget = std::rand() % 3000;
+
+            for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+                schedule.setPower(heater, std::rand() % 2 ? 0 : std::rand() % 30);
+
+                if(std::rand() % 3 == 0) heaters.insert(heaters.begin(), heater);
+            }
+
+            // Пики до распределения - после обнуления мощностей набора
+            for(HeaterNum heater: heaters) schedule.setPower(heater, 0);
+
+            auto before = schedule.getMaximumEvenOddHeaters();
+            std::uint32_t distributed = schedule.distributePowerBudget(heaters, budget, std::max(maxEven, before.first),
+                                                                       std::max(maxOdd, before.second), powers);
+            std::uint32_t sum = 0;
+
+            for(const auto& heaterAndPower: powers) {
+                ASSERT_EQ(schedule.getPower(heaterAndPower.first), heaterAndPower.second);
+                sum += heaterAndPower.second;
+            }
+
+            ASSERT_EQ(powers.size(), heaters.size());
+            ASSERT_EQ(distributed, sum);
+            ASSERT_LE(distributed, budget);
+            ASSERT_LE(schedule.getMaximumEvenOddHeaters().first, std::max(maxEven, before.first));
+            ASSERT_LE(schedule.getMaximumEvenOddHeaters().second, std::max(maxOdd, before.second));
+        }
+    }
+}
+
+TEST(HeatSchedule, group_counters_match_frame_bits) {
+    for(ScheduleLayout layout: {ScheduleLayout::SEQUENTIAL, ScheduleLayout::BALANCED}) {
+        const HeaterNum heatersNum = 40;
+        const GroupNum groupsCount = 5;
+        HeatSchedule schedule(heatersNum, 100, layout);
+        GroupMemberships memberships(heatersNum);
+
+        // Три фазы и два фидера
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            memberships[heater] = {static_cast<GroupNum>(heater % 3), static_cast<GroupNum>(3 + heater / 20)};
+        }
+
+        ASSERT_FALSE(schedule.setGroups(2, memberships));
+        ASSERT_TRUE(schedule.setGroups(groupsCount, memberships));
+
+        auto expectedPeaks = [&](const HeatSchedule& checked) {
+            std::vector<HeaterNum> peaks(groupsCount, 0);
+
+            for(Frame frame = 0; frame < 100; ++frame) {
+                std::vector<HeaterNum> counts(groupsCount, 0);
+
+                for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+                    if(!checked.isHeating(heater, frame)) continue;
+
+                    for(GroupNum group: memberships[heater]) ++counts[group];
+                }
+
+                for(GroupNum group = 0; group < groupsCount; ++group) {
+                    EXPECT_EQ(checked.getGroupCounts(frame)[group], counts[group]);
+                    peaks[group] = std::max(peaks[group], counts[group]);
+                }
+            }
+
+            return peaks;
+        };
+
+        std::vector<HeaterNum> peaks;
+        std::vector<int> diff;
+
+        std::srand(47);
+        for(int change = 0; change < 100; ++change) {
+            HeaterNum heater = std::rand() % heatersNum;
+            Power power = std::rand() % 101;
+            HeatSchedule changed = schedule;
+
+            changed.setPower(heater, power);
+            schedule.getMaximumGroupHeatersAfterPowerChange(heater, power, peaks, diff);
+
+            ASSERT_EQ(peaks, expectedPeaks(changed));
+
+            if(change % 10 == 0) {
+                schedule.setPowers({{heater, power}});
+            } else {
+                schedule.setPower(heater, power);
+            }
+
+            schedule.getMaximumGroupHeaters(peaks);
+
+            ASSERT_EQ(peaks, expectedPeaks(schedule));
+        }
+    }
+}
+
+TEST(HeatSchedule, rebuild_matches_incremental_update) {
+    const HeaterNum heatersNum = 150;
+
+    HeatSchedule incremental(heatersNum, 100);
+    HeatSchedule rebuilt(heatersNum, 100);
+    HeaterPowers powers;
+
+    std::srand(3);
+    for(HeaterNum num = 0; num < heatersNum; ++num) {
+        Power power = std::rand() % 101;
+
+        incremental.setPower(num, power);
+        powers.emplace_back(num, power);
+    }
+
+    rebuilt.setPowers(powers);
+
+    ASSERT_EQ(rebuilt.getWordsPerFrame(), 3u);
+
+    for(Frame frame = 0; frame < 100; ++frame) {
+        for(HeaterNum word = 0; word < rebuilt.getWordsPerFrame(); ++word) {
+            ASSERT_EQ(rebuilt.getFrameWords(frame)[word], incremental.getFrameWords(frame)[word]);
+        }
+
+        ASSERT_EQ(rebuilt.getFrame(frame).getEvenHeatersCount(), incremental.getFrame(frame).getEvenHeatersCount());
+        ASSERT_EQ(rebuilt.getFrame(frame).getOddHeatersCount(), incremental.getFrame(frame).getOddHeatersCount());
+    }
+}
+
+
+/**
+ * Сбалансированная раскладка даёт наименьшие возможные пики
+ * верхних и нижних нагревателей и сохраняет мощность каждого нагревателя
+ */
+TEST(HeatSchedule, balanced_layout_reaches_lower_bound_of_peaks) {
+    const HeaterNum heatersNum = 1000;
+
+    HeatSchedule sequential(heatersNum, 100);
+    HeatSchedule balanced(heatersNum, 100, ScheduleLayout::BALANCED);
+    Power evenTotal = 0;
+    Power oddTotal = 0;
+
+    std::srand(11);
+    for(int step = 0; step < 3000; ++step) {
+        HeaterNum heater = std::rand() % heatersNum;
+        Power power = std::rand() % 101;
+
+        (heater % 2 == 0 ? evenTotal : oddTotal) += power;
+        (heater % 2 == 0 ? evenTotal : oddTotal) -= balanced.getPower(heater);
+
+        sequential.setPower(heater, power);
+        balanced.setPower(heater, power);
+    }
+
+    auto peaks = balanced.getMaximumEvenOddHeaters();
+    auto sequentialPeaks = sequential.getMaximumEvenOddHeaters();
+
+    ASSERT_EQ(peaks.first, (evenTotal + 99) / 100);
+    ASSERT_EQ(peaks.second, (oddTotal + 99) / 100);
+    ASSERT_LE(peaks.first, sequentialPeaks.first);
+    ASSERT_LE(peaks.second, sequentialPeaks.second);
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        Power frames = 0;
+
+        for(Frame frame = 0; frame < 100; ++frame) {
+            if(balanced.isHeating(heater, frame)) ++frames;
+        }
+
+        ASSERT_EQ(frames, balanced.getPower(heater));
+    }
+
+    // Перестроение и оценка после изменения согласованы с инкрементальной раскладкой
+    HeatSchedule rebuilt(heatersNum, 100, ScheduleLayout::BALANCED);
+    HeaterPowers powers;
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        powers.emplace_back(heater, balanced.getPower(heater));
+    }
+
+    rebuilt.setPowers(powers);
+
+    ASSERT_EQ(rebuilt.getMaximumEvenOddHeaters(), peaks);
+    ASSERT_EQ(balanced.getMaximumEvenOddHeatersAfterPowerChange(1, 0),
+              rebuilt.getMaximumEvenOddHeatersAfterPowerChange(1, 0));
+}
+
+
+#if HEATERS_INSTRUMENTATION
+/**
+ * Замеры считают вызовы горячего пути и пропуски дедлайна
+ */
+TEST(HeatersMetrics, counts_hot_path_calls_and_deadline_misses) {
+    Heaters heaters(70, [](HeaterNum, bool) {});
+
+    heaters.setPower(3, 40);
+    heaters.setPower(69, 70);
+    heaters.setPowers({{1, 10}, {2, 20}});
+
+    for(int i = 0; i < 250; ++i) heaters.zeroCrossed();
+
+    HeatersMetricsSnapshot metrics = heaters.getMetrics();
+
+    ASSERT_EQ(metrics.zeroCrossed.count, 250u);
+    ASSERT_EQ(metrics.heating.count, 250u);
+    ASSERT_EQ(metrics.update.count, 2u);
+    // Две установки, набор и его вступление в силу
+    ASSERT_EQ(metrics.scheduleUpdate.count, 4u);
+    ASSERT_EQ(metrics.sinkCalls, 250u);
+    ASSERT_EQ(metrics.deadline, HeatersMetrics::DEFAULT_DEADLINE);
+
+    std::uint64_t bucketsTotal = 0;
+
+    for(std::uint64_t bucket: metrics.heating.buckets) bucketsTotal += bucket;
+
+    ASSERT_EQ(bucketsTotal, metrics.heating.count);
+    ASSERT_LE(metrics.heating.maxNanoseconds, metrics.zeroCrossed.totalNanoseconds);
+    ASSERT_GE(metrics.heating.getPercentileBound(1.0), metrics.heating.maxNanoseconds / 2);
+
+    heaters.setDeadline(std::chrono::nanoseconds(0));
+    std::uint64_t misses = metrics.deadlineMisses;
+
+    for(int i = 0; i < 10; ++i) heaters.zeroCrossed();
+
+    ASSERT_GT(heaters.getMetrics().deadlineMisses, misses);
+}
+
+TEST(HeatersMetrics, log_buckets_double_in_width) {
+    ASSERT_EQ(LatencyHistogram::getBucket(0), 0u);
+    ASSERT_EQ(LatencyHistogram::getBucket(1), 1u);
+    ASSERT_EQ(LatencyHistogram::getBucket(2), 2u);
+    ASSERT_EQ(LatencyHistogram::getBucket(3), 2u);
+    ASSERT_EQ(LatencyHistogram::getBucket(1024), 11u);
+    ASSERT_EQ(LatencyHistogram::getBucket(UINT64_MAX), LatencySnapshot::BUCKETS_COUNT - 1);
+}
+#endif
+
+/**
+ * Команды из нескольких потоков управления применяются потоком перехода через ноль,
+ * наборы применяются целиком
+ */
+TEST(ConcurrentHeaters, applies_commands_from_many_threads) {
+    const HeaterNum heatersNum = 64;
+    const int threadsNum = 4;
+
+    ConcurrentHeaters heaters(heatersNum, [](int, bool) {}, 32);
+    std::atomic<int> finished{0};
+    std::vector<std::thread> threads;
+
+    for(int thread = 0; thread < threadsNum; ++thread) {
+        threads.emplace_back([&heaters, &finished, thread]() {
+            for(Power power = 0; power <= 100; ++power) {
+                for(HeaterNum heater = thread; heater < heatersNum; heater += threadsNum) {
+                    heaters.setPower(heater, power);
+                }
+
+                // Снимок читается параллельно с полупериодами
+                unsigned int top = 0, bot = 0;
+                heaters.getMaxNumOfTurnedHeatersAfterPowerChange(thread, power, top, bot);
+                heaters.getLastSemiPeriodState(thread);
+                heaters.getPower(thread, power % 3);
+            }
+
+            // Нагреватели потока получают итоговую мощность одной транзакцией
+            HeaterPowers powers;
+            for(HeaterNum heater = thread; heater < heatersNum; heater += threadsNum) {
+                powers.emplace_back(heater, heater % 101);
+            }
+            while(!heaters.setPowers(powers)) {
+                std::this_thread::yield();
+            }
+
+            ++finished;
+        });
+    }
+
+    // Поток перехода через ноль
+    while(finished < threadsNum) {
+        heaters.zeroCrossed();
+        heaters.getLastSemiPeriodState(0);
+    }
+
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+
+    for(int i = 0; i < 2 * 100; ++i) {
+        heaters.zeroCrossed();
+    }
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        ASSERT_EQ(heaters.getPower(heater), heater % 101);
+    }
+}
+
+TEST(ConcurrentHeaters, snapshot_matches_heaters) {
+    const HeaterNum heatersNum = 100;
+
+    Heaters expected(heatersNum, [](int, bool) {});
+    ConcurrentHeaters heaters(heatersNum, [](int, bool) {});
+
+    std::srand(11);
+
+    for(int frame = 0; frame < 8 * 100; ++frame) {
+        // Одиночные команды, наборы с обоими способами вступления и выключение нагревателей
+        if(frame % 7 == 0) {
+            HeaterNum heater = std::rand() % heatersNum;
+            Power power = frame % 300 < 200 ? std::rand() % 101 : 0;
+
+            expected.setPower(heater, power);
+            heaters.setPower(heater, power);
+        }
+
+        if(frame % 90 == 45) {
+            HeaterPowers powers = {{static_cast<HeaterNum>(std::rand() % heatersNum), 30}, {64, 0}, {65, 70}};
+            PowersCommit commit = frame % 180 == 45 ? PowersCommit::NEXT_SECOND : PowersCommit::NEXT_FRAME;
+
+            expected.setPowers(powers, commit);
+            ASSERT_TRUE(heaters.setPowers(powers, commit));
+        }
+
+        expected.zeroCrossed();
+        heaters.zeroCrossed();
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            ASSERT_EQ(heaters.getLastSemiPeriodState(heater), expected.getLastSemiPeriodState(heater));
+        }
+
+        unsigned int expectedTop = 0, expectedBot = 0, top = 0, bot = 0;
+        expected.getMaxNumOfTurnedHeatersAfterPowerChange(frame % heatersNum, 55, expectedTop, expectedBot);
+        heaters.getMaxNumOfTurnedHeatersAfterPowerChange(frame % heatersNum, 55, top, bot);
+
+        ASSERT_EQ(top, expectedTop);
+        ASSERT_EQ(bot, expectedBot);
+    }
+
+    // Слова выключенных нагревателей исключаются из активных
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        expected.setPower(heater, 0);
+        heaters.setPower(heater, 0);
+    }
+
+    for(int frame = 0; frame < 3; ++frame) {
+        expected.zeroCrossed();
+        heaters.zeroCrossed();
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            ASSERT_EQ(heaters.getLastSemiPeriodState(heater), expected.getLastSemiPeriodState(heater));
+        }
+    }
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        for(unsigned short offset = 0; offset <= 10; ++offset) {
+            ASSERT_EQ(heaters.getPower(heater, offset), expected.getPower(heater, offset));
+        }
+    }
+
+    // Между запросами пиков изменений больше, чем помещается в журнал
+    for(int round = 0; round < 3; ++round) {
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            Power power = static_cast<Power>(std::rand() % 101);
+
+            expected.setPower(heater, power);
+            heaters.setPower(heater, power);
+        }
+
+        expected.zeroCrossed();
+        heaters.zeroCrossed();
+    }
+
+    unsigned int expectedTop = 0, expectedBot = 0, top = 0, bot = 0;
+    expected.getMaxNumOfTurnedHeatersAfterPowerChange(3, 55, expectedTop, expectedBot);
+    heaters.getMaxNumOfTurnedHeatersAfterPowerChange(3, 55, top, bot);
+
+    ASSERT_EQ(top, expectedTop);
+    ASSERT_EQ(bot, expectedBot);
+
+    // Для несуществующего нагревателя - текущие пики
+    expected.getMaxNumOfTurnedHeatersAfterPowerChange(0, Heater::MAXIMUM_POWER + 1, expectedTop, expectedBot);
+    heaters.getMaxNumOfTurnedHeatersAfterPowerChange(heatersNum, 55, top, bot);
+
+    ASSERT_EQ(top, expectedTop);
+    ASSERT_EQ(bot, expectedBot);
+}
+
+
+TEST(ScheduleBuilder, builds_schedules_like_synchronous_heaters) {
+    const HeaterNum heatersNum = 150;
+    std::vector<bool> syncStates(heatersNum, false);
+    std::vector<bool> builtStates(heatersNum, false);
+
+    Heaters sync(heatersNum, [&syncStates](HeaterNum heater, bool state) {
+        syncStates[heater] = state;
+    }, ScheduleLayout::BALANCED);
+    Heaters built(heatersNum, [&builtStates](HeaterNum heater, bool state) {
+        builtStates[heater] = state;
+    }, ScheduleLayout::BALANCED);
+
+    // Отложенная схема setPowers() передаётся потоку построения
+    HeaterPowers initial = {{3, 50}, {70, 20}};
+
+    sync.setPowers(initial);
+    built.setPowers(initial);
+    built.startScheduleBuilder();
+
+    std::srand(44);
+    for(int frame = 0; frame < 1000; ++frame) {
+        // Несколько запросов между переходами через ноль объединяются в одну схему
+        for(int request = std::rand() % 4; request > 0; --request) {
+            HeaterNum heater = std::rand() % heatersNum;
+            Power power = std::rand() % 102;
+
+            sync.setPower(heater, power);
+            built.setPower(heater, power);
+        }
+
+        if(frame % 30 == 0) {
+            HeaterPowers powers = {{static_cast<HeaterNum>(std::rand() % heatersNum), 77},
+                                   {static_cast<HeaterNum>(std::rand() % heatersNum), 0}};
+
+            sync.setPowers(powers);
+            built.setPowers(powers);
+        }
+
+        built.waitScheduleBuilder();
+
+        sync.zeroCrossed();
+        built.zeroCrossed();
+
+        ASSERT_EQ(syncStates, builtStates) << "frame " << frame;
+    }
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        ASSERT_EQ(sync.getPower(heater, 1), built.getPower(heater, 1));
+    }
+
+    // Схема NEXT_SECOND вступает в силу только с начала секунды
+    built.setPowers({{5, 0}, {6, 0}});
+    built.waitScheduleBuilder();
+
+    for(Frame frame = 0; frame < 10; ++frame) {
+        built.zeroCrossed();
+    }
+
+    built.setPowers({{5, 100}}, PowersCommit::NEXT_SECOND);
+    built.waitScheduleBuilder();
+
+    while(built.getCurrentFrame() != 0) {
+        built.zeroCrossed();
+        ASSERT_FALSE(builtStates[5]);
+    }
+
+    built.zeroCrossed();
+
+    ASSERT_TRUE(builtStates[5]);
+
+    // Не вступившая в силу схема сохраняется при возврате в синхронный режим
+    built.setPowers({{6, 100}}, PowersCommit::NEXT_SECOND);
+    built.stopScheduleBuilder();
+
+    while(built.getCurrentFrame() != 0) {
+        built.zeroCrossed();
+        ASSERT_FALSE(builtStates[6]);
+    }
+
+    built.zeroCrossed();
+
+    ASSERT_TRUE(builtStates[6]);
+}
+
+TEST(ScheduleBuilder, replacing_schedule_keeps_changes_of_the_replaced_one) {
+    const HeaterNum heatersNum = 130;
+    std::vector<bool> states(heatersNum, false);
+
+    Heaters heaters(heatersNum, [&states](HeaterNum heater, bool state) {
+        states[heater] = state;
+    });
+
+    heaters.startScheduleBuilder();
+    heaters.zeroCrossed();
+
+    // Первая схема не забрана до начала секунды и заменяется второй
+    heaters.setPowers({{100, 100}}, PowersCommit::NEXT_SECOND);
+    heaters.waitScheduleBuilder();
+    heaters.setPowers({{10, 100}}, PowersCommit::NEXT_SECOND);
+    heaters.waitScheduleBuilder();
+
+    while(heaters.getCurrentFrame() != 0) {
+        heaters.zeroCrossed();
+    }
+
+    heaters.zeroCrossed();
+
+    ASSERT_TRUE(states[10]);
+    ASSERT_TRUE(states[100]);
+
+    for(Frame frame = 0; frame < heaters.getFrameCount(); ++frame) {
+        heaters.zeroCrossed();
+    }
+
+    ASSERT_EQ(heaters.getPower(10, 0), 100);
+    ASSERT_EQ(heaters.getPower(100, 0), 100);
+}
+
+TEST(ScheduleBuilder, keeps_latest_powers_requested_from_many_threads) {
+    const HeaterNum heatersNum = 64;
+    const int threadsNum = 4;
+
+    Heaters heaters(heatersNum, [](int, bool) {});
+    std::atomic<int> finished{0};
+    std::vector<std::thread> threads;
+
+    heaters.startScheduleBuilder();
+
+    for(int thread = 0; thread < threadsNum; ++thread) {
+        threads.emplace_back([&heaters, &finished, thread]() {
+            for(Power power = 0; power <= 100; ++power) {
+                for(HeaterNum heater = thread; heater < heatersNum; heater += threadsNum) {
+                    heaters.setPower(heater, power);
+                }
+            }
+
+            HeaterPowers powers;
+            for(HeaterNum heater = thread; heater < heatersNum; heater += threadsNum) {
+                powers.emplace_back(heater, heater % 101);
+            }
+            heaters.setPowers(powers);
+
+            ++finished;
+        });
+    }
+
+    // Поток перехода через ноль забирает схемы, не дожидаясь построения
+    while(finished < threadsNum) {
+        heaters.zeroCrossed();
+    }
+
+    for(std::thread& thread: threads) {
+        thread.join();
+    }
+
+    heaters.stopScheduleBuilder();
+
+    for(int i = 0; i < 2 * 100; ++i) {
+        heaters.zeroCrossed();
+    }
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        ASSERT_EQ(heaters.getPower(heater), heater % 101);
+    }
+}
+
+TEST(StateMirror, mirrors_powers_and_states_into_shared_memory) {
+    const HeaterNum heatersNum = 150;
+    const std::string name = "/heaters_test_mirror_" + std::to_string(::getpid());
+
+    Heaters heaters(heatersNum, [](HeaterNum, bool) {}, ScheduleLayout::BALANCED);
+    StateMirrorReader reader;
+    StateMirrorSnapshot snapshot;
+    std::vector<Power> powers(heatersNum, 0);
+
+    ASSERT_FALSE(reader.open(name));
+    ASSERT_TRUE(heaters.attachStateMirror(name));
+    ASSERT_TRUE(reader.open(name));
+    ASSERT_EQ(reader.getHeatersCount(), heatersNum);
+
+    std::srand(45);
+    for(int frame = 0; frame < 1000; ++frame) {
+        HeaterNum heater = std::rand() % heatersNum;
+        // Выключенные нагреватели исключают слова из активных
+        Power power = std::rand() % 3 ? 0 : std::rand() % 101;
+
+        heaters.setPower(heater, power);
+
+        // Мощность попадает в сегмент только при публикации полупериода
+        ASSERT_TRUE(reader.read(snapshot));
+        ASSERT_EQ(snapshot.powers, powers);
+
+        powers[heater] = power;
+
+        if(frame % 20 == 0) {
+            HeaterPowers batch = {{static_cast<HeaterNum>(std::rand() % heatersNum), 60}};
+
+            heaters.setPowers(batch);
+            powers[batch[0].first] = batch[0].second;
+        }
+
+        heaters.zeroCrossed();
+
+        ASSERT_TRUE(reader.read(snapshot));
+        ASSERT_EQ(snapshot.powers, powers);
+        ASSERT_EQ(snapshot.frame, heaters.getCurrentFrame());
+        ASSERT_EQ(snapshot.historyEpoch, static_cast<std::uint32_t>((frame + 1) / 100));
+        ASSERT_EQ(snapshot.frames, static_cast<std::uint64_t>(frame + 2));
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            ASSERT_EQ(snapshot.getLastSemiPeriodState(heater), heaters.getLastSemiPeriodState(heater));
+        }
+    }
+
+    // Выключение всех нагревателей: слова становятся неактивными, их состояния обнуляются
+    HeaterPowers off;
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        off.emplace_back(heater, 0);
+    }
+
+    heaters.setPowers(off);
+
+    for(int frame = 0; frame < 3; ++frame) {
+        heaters.zeroCrossed();
+
+        ASSERT_TRUE(reader.read(snapshot));
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            ASSERT_EQ(snapshot.getLastSemiPeriodState(heater), heaters.getLastSemiPeriodState(heater));
+        }
+    }
+
+    // Читатель в другом потоке (со своим отображением сегмента) видит только целые записи
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::thread monitor([&name, &stop, &torn]() {
+        StateMirrorReader monitorReader;
+        StateMirrorSnapshot monitorSnapshot;
+
+        if(!monitorReader.open(name)) {
+            ++torn;
+            return;
+        }
+
+        while(!stop) {
+            monitorReader.read(monitorSnapshot);
+
+            bool samePowers = std::all_of(monitorSnapshot.powers.begin(), monitorSnapshot.powers.end(),
+                                          [&monitorSnapshot](Power power) {
+                                              return power == monitorSnapshot.powers[0];
+                                          });
+
+            if(!samePowers || monitorSnapshot.frame != (monitorSnapshot.frames - 1) % 100) ++torn;
+        }
+    });
+
+    HeaterPowers all;
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        all.emplace_back(heater, 0);
+    }
+
+    for(int frame = 0; frame < 2000; ++frame) {
+        for(auto& heaterAndPower: all) {
+            heaterAndPower.second = frame % 101;
+        }
+
+        heaters.setPowers(all);
+        heaters.zeroCrossed();
+    }
+
+    stop = true;
+    monitor.join();
+
+    ASSERT_EQ(torn.load(), 0);
+}
+
+/**
+ * Сумма, среднее, минимум и максимум по интервалам истории совпадают
+ * с вычисленными перебором
+ */
+TEST(PowerHistory, range_statistics_match_brute_force) {
+    PowerHistory history(2);
+    std::vector<Power> powers;
+
+    std::srand(17);
+    for(int second = 0; second < 1500; ++second) {
+        Power power = std::rand() % 101;
+
+        history.roll();
+        history.record(0, power);
+        history.record(1, 100 - power);
+        powers.insert(powers.begin(), power);
+    }
+
+    for(int query = 0; query < 2000; ++query) {
+        unsigned short from = std::rand() % 650;
+        unsigned short to = from + std::rand() % 650;
+
+        std::uint32_t sum = 0;
+        Power minPower = 100;
+        Power maxPower = 0;
+
+        for(unsigned short offset = from; offset <= to; ++offset) {
+            Power power = offset < PowerHistory::TIME_LIMIT ? powers[offset] : 0;
+
+            sum += power;
+            minPower = std::min(minPower, power);
+            maxPower = std::max(maxPower, power);
+        }
+
+        if(from >= PowerHistory::TIME_LIMIT) {
+            minPower = 0;
+        }
+
+        ASSERT_EQ(history.getPowerSum(0, from, to), sum);
+        ASSERT_EQ(history.getMinPower(0, from, to), minPower);
+        ASSERT_EQ(history.getMaxPower(0, from, to), maxPower);
+    }
+
+    ASSERT_EQ(history.getAveragePower(1, 2), (200 - powers[0] - powers[1] + 1) / 2);
+}
+
+TEST(PowerHistory, downsampled_tiers_match_brute_force) {
+    PowerHistory history(1);
+    // Мощности в порядке записи
+    std::vector<Power> powers;
+    const std::uint32_t seconds = 3 * 3600 + 25 * 60 + 37;
+
+    std::srand(23);
+    for(std::uint32_t second = 0; second < seconds; ++second) {
+        Power power = std::rand() % 101;
+
+        history.roll();
+        history.record(0, power);
+        powers.push_back(power);
+    }
+
+    // Сводка по секундам [from, to) в порядке записи
+    auto aggregate = [&powers](std::uint32_t from, std::uint32_t to) {
+        PowerAggregate result;
+
+        result.min = 100;
+        result.seconds = to - from;
+
+        for(std::uint32_t second = from; second < to; ++second) {
+            result.sum += powers[second];
+            result.min = std::min(result.min, powers[second]);
+            result.max = std::max(result.max, powers[second]);
+        }
+
+        return result;
+    };
+
+    for(std::uint32_t offset = 0; offset < 30 * 3600; offset += 7) {
+        PowerAggregate expected;
+        std::uint32_t minute = (offset - std::min(offset, seconds % 60)) / 60;
+        std::uint32_t hour = (offset - std::min(offset, seconds % 3600)) / 3600;
+
+        if(offset < PowerHistory::TIME_LIMIT) {
+            expected = aggregate(seconds - 1 - offset, seconds - offset);
+        } else if(minute < PowerHistory::MINUTES_LIMIT) {
+            std::uint32_t end = (seconds / 60 - minute) * 60;
+
+            expected = aggregate(end - 60, end);
+        } else if(hour < seconds / 3600) {
+            std::uint32_t end = (seconds / 3600 - hour) * 3600;
+
+            expected = aggregate(end - 3600, end);
+        }
+
+        PowerAggregate actual = history.getPowerAggregate(0, offset);
+
+        ASSERT_EQ(actual.seconds, expected.seconds) << offset;
+        ASSERT_EQ(actual.sum, expected.sum) << offset;
+        ASSERT_EQ(actual.min, expected.min) << offset;
+        ASSERT_EQ(actual.max, expected.max) << offset;
+    }
+}
+
+TEST(PowerHistory, idle_seconds_match_recorded_zeros) {
+    const HeaterNum heatersNum = 4;
+    // eager записывает все секунды, lazy - только ненулевые
+    PowerHistory eager(heatersNum);
+    PowerHistory lazy(heatersNum);
+    std::uint32_t second = 0;
+
+    auto compare = [&]() {
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            for(unsigned short offset = 0; offset < PowerHistory::TIME_LIMIT; offset += 7) {
+                unsigned short to = offset + std::rand() % 200;
+
+                ASSERT_EQ(lazy.getPower(heater, offset), eager.getPower(heater, offset)) << second;
+                ASSERT_EQ(lazy.getPowerSum(heater, offset, to), eager.getPowerSum(heater, offset, to)) << second;
+                ASSERT_EQ(lazy.getMinPower(heater, offset, to), eager.getMinPower(heater, offset, to)) << second;
+                ASSERT_EQ(lazy.getMaxPower(heater, offset, to), eager.getMaxPower(heater, offset, to)) << second;
+            }
+
+            for(std::uint32_t offset = 0; offset < 26 * 3600; offset += 97) {
+                PowerAggregate expected = eager.getPowerAggregate(heater, offset);
+                PowerAggregate actual = lazy.getPowerAggregate(heater, offset);
+
+                ASSERT_EQ(actual.seconds, expected.seconds) << second << " " << offset;
+                ASSERT_EQ(actual.sum, expected.sum) << second << " " << offset;
+                ASSERT_EQ(actual.min, expected.min) << second << " " << offset;
+                ASSERT_EQ(actual.max, expected.max) << second << " " << offset;
+            }
+        }
+    };
+
+    std::srand(53);
+    for(int burst = 0; burst < 120; ++burst) {
+        // Простой от секунд до суток с лишним, затем несколько секунд работы
+        std::uint32_t idle = std::rand() % (burst % 3 ? 90 : 1500);
+
+        if(burst % 40 == 0) idle = 27 * 3600 + std::rand() % 3600;
+        if(burst % 40 == 20 || burst % 40 == 30) idle = 3600 + std::rand() % 7200;
+
+        std::uint32_t busy = 1 + std::rand() % 120;
+
+        for(std::uint32_t step = 0; step < idle + busy; ++step, ++second) {
+            eager.roll();
+            lazy.roll();
+
+            for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+                // Нагреватель 0 работает всегда, остальные - только вне простоя
+                Power power = step < idle && heater ? 0 : std::rand() % 101;
+
+                eager.record(heater, power);
+
+                if(power) lazy.record(heater, power);
+            }
+
+            // Сверяем и посреди простоя, пока нулевые секунды ещё не дописаны
+            if(step + 1 == idle && (burst % 10 == 5 || idle > 3600)) compare();
+            if(HasFatalFailure()) return;
+        }
+
+        if(burst % 10 == 0) compare();
+        if(HasFatalFailure()) return;
+    }
+
+    compare();
+}
+
+TEST(PowerHistory, restores_history_and_powers_from_file) {
+    const std::string path = testing::TempDir() + "heaters_history_test.bin";
+    HeatSetter setter = [](HeaterNum, bool) {};
+
+    std::remove(path.c_str());
+
+    {
+        Heaters heaters(3, setter);
+
+        ASSERT_EQ(heaters.attachHistoryFile(path), HistoryFile::CREATED);
+
+        heaters.setPower(0, 30);
+        heaters.setPower(2, 75);
+
+        for(int i = 0; i < 1000; ++i) heaters.zeroCrossed();
+
+        heaters.setPower(1, 10);
+        heaters.setPower(2, 50);
+
+        for(int i = 0; i < 500; ++i) heaters.zeroCrossed();
+    }
+
+    Heaters heaters(3, setter);
+
+    ASSERT_EQ(heaters.attachHistoryFile(path), HistoryFile::RESTORED);
+
+    ASSERT_EQ(heaters.getPower(2, 0), 50);
+    ASSERT_EQ(heaters.getPower(2, 5), 75);
+    ASSERT_EQ(heaters.getPower(1, 4), 10);
+    ASSERT_EQ(heaters.getPower(1, 5), 0);
+    ASSERT_EQ(heaters.getPowerSum(0, 0, 14), 30u * 15);
+
+    // Мощности продолжают действовать после перезапуска
+    for(int i = 0; i < 100; ++i) heaters.zeroCrossed();
+
+    ASSERT_EQ(heaters.getPower(0, 0), 30);
+    ASSERT_EQ(heaters.getPower(1, 0), 10);
+    ASSERT_EQ(heaters.getPower(2, 0), 50);
+    ASSERT_EQ(heaters.getPower(2, 1), 50);
+
+    // Несовместимый файл перезаписывается текущим состоянием
+    Heaters other(4, setter);
+
+    ASSERT_EQ(other.attachHistoryFile(path), HistoryFile::CREATED);
+    ASSERT_EQ(other.getPower(2, 1), 0);
+
+    std::remove(path.c_str());
+}
+
+TEST(HeaterZones, runs_zones_in_parallel_like_serial_heaters) {
+    const std::size_t zonesCount = 12;
+    HeaterZones zones(4);
+    std::vector<std::unique_ptr<Heaters>> serial;
+    std::vector<std::vector<std::vector<bool>>> parallelStates(zonesCount);
+    std::vector<std::vector<std::vector<bool>>> serialStates(zonesCount);
+
+    std::srand(29);
+    for(std::size_t zone = 0; zone < zonesCount; ++zone) {
+        HeaterNum heatersNum = 1 + zone * 7;
+
+        parallelStates[zone].assign(heatersNum, {});
+        serialStates[zone].assign(heatersNum, {});
+
+        auto& parallel = parallelStates[zone];
+        auto& expected = serialStates[zone];
+
+        zones.addZone(heatersNum, [&parallel](HeaterNum heater, bool state) {
+            parallel[heater].push_back(state);
+        });
+        serial.push_back(std::make_unique<Heaters>(heatersNum, [&expected](HeaterNum heater, bool state) {
+            expected[heater].push_back(state);
+        }));
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            Power power = std::rand() % 101;
+
+            zones.getZone(zone).setPower(heater, power);
+            serial[zone]->setPower(heater, power);
+        }
+    }
+
+    for(int i = 0; i < 250; ++i) {
+        zones.zeroCrossed();
+
+        for(auto& heaters: serial) heaters->zeroCrossed();
+    }
+
+    for(std::size_t zone = 0; zone < zonesCount; ++zone) {
+        ASSERT_EQ(parallelStates[zone], serialStates[zone]) << zone;
+
+        for(HeaterNum heater = 0; heater < parallelStates[zone].size(); ++heater) {
+            ASSERT_EQ(zones.getZone(zone).getPower(heater, 1), serial[zone]->getPower(heater, 1));
+        }
+    }
+}
+
+TEST(HeaterZones, aggregates_peaks_of_zones_in_different_frames) {
+    HeaterZones zones(2);
+    HeatSetter setter = [](HeaterNum, bool) {};
+
+    zones.addZone(4, setter);
+    zones.getZone(0).setPower(0, 50);
+    zones.getZone(0).setPower(2, 50);
+
+    for(int i = 0; i < 50; ++i) zones.zeroCrossed();
+
+    // Вторая зона начинает секунду, когда первая уже прошла её половину
+    zones.addZone(4, setter);
+    zones.getZone(1).setPower(0, 50);
+    zones.getZone(1).setPower(2, 50);
+
+    unsigned int top = 0;
+    unsigned int bot = 0;
+
+    zones.getMaxNumOfTurnedHeaters(top, bot);
+
+    // В каждой зоне пик верхних - 1, но зоны сдвинуты на 50 полупериодов и пики совпадают
+    ASSERT_EQ(top, 2u);
+    ASSERT_EQ(bot, 0u);
+
+    zones.getZone(1).setPower(0, 0);
+    zones.getZone(1).setPower(2, 40);
+    zones.getMaxNumOfTurnedHeaters(top, bot);
+
+    ASSERT_EQ(top, 2u);
+
+    zones.getZone(0).setPower(2, 0);
+    zones.getMaxNumOfTurnedHeaters(top, bot);
+
+    // Первая зона греет в полупериодах 0-49, т.е. для второй в 50-99, вторая - в 0-39
+    ASSERT_EQ(top, 1u);
+}
+
+TEST(Advance, matches_frame_by_frame_run) {
+    for(ScheduleLayout layout: {ScheduleLayout::SEQUENTIAL, ScheduleLayout::BALANCED}) {
+        const HeaterNum heatersNum = 37;
+        HeatSetter setter = [](HeaterNum, bool) {};
+        Heaters stepped(heatersNum, setter, layout);
+        Heaters advanced(heatersNum, setter, layout);
+
+        std::srand(31);
+        for(int chunk = 0; chunk < 300; ++chunk) {
+            switch(std::rand() % 3) {
+                case 0: {
+                    HeaterNum heater = std::rand() % heatersNum;
+                    Power power = std::rand() % 101;
+
+                    stepped.setPower(heater, power);
+                    advanced.setPower(heater, power);
+                    break;
+                }
+                case 1: {
+                    HeaterPowers powers = {{std::rand() % heatersNum, std::rand() % 101},
+                                           {std::rand() % heatersNum, std::rand() % 101}};
+                    PowersCommit commit = std::rand() % 2 ? PowersCommit::NEXT_FRAME : PowersCommit::NEXT_SECOND;
+
+                    stepped.setPowers(powers, commit);
+                    advanced.setPowers(powers, commit);
+                    break;
+                }
+                default:
+                    break;
+            }
+
+            std::uint64_t frames = std::rand() % 4 == 0 ? std::rand() % 3 : std::rand() % 450;
+
+            for(std::uint64_t frame = 0; frame < frames; ++frame) stepped.zeroCrossed();
+
+            advanced.advanceFrames(frames);
+
+            ASSERT_EQ(advanced.getCurrentFrame(), stepped.getCurrentFrame());
+
+            for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+                ASSERT_EQ(advanced.getLastSemiPeriodState(heater), stepped.getLastSemiPeriodState(heater))
+                                            << chunk << " " << heater;
+            }
+        }
+
+        advanced.advance(2);
+        for(int frame = 0; frame < 200; ++frame) stepped.zeroCrossed();
+
+        for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+            for(unsigned short offset = 0; offset < PowerHistory::TIME_LIMIT; ++offset) {
+                ASSERT_EQ(advanced.getPower(heater, offset), stepped.getPower(heater, offset)) << heater;
+            }
+        }
+    }
+}
+
+TEST(EventRecorder, replay_reproduces_recorded_run) {
+    struct CountingSink : IHeatSink {
+        void setStates(const HeatStateWord*, const HeatStateWord*, std::size_t) override {
+            ++calls;
+        }
+
+        void setActiveStates(const HeatStateWord*, const HeatStateWord*, std::size_t,
+                             const HeaterNum*, std::size_t) override {
+            ++activeCalls;
+        }
+
+        std::size_t calls = 0;
+        std::size_t activeCalls = 0;
+    } sink;
+
+    const HeaterNum heatersNum = 70;
+    RecordingHeaters heaters(heatersNum, sink, 1 << 16, ScheduleLayout::BALANCED);
+    HeaterPowers batch = {{3, 40}, {69, 90}, {12, 15}};
+
+    std::size_t before = getAllocationsCount();
+
+    std::srand(47);
+    for(int frame = 0; frame < 1050; ++frame) {
+        if(frame < 1000 && std::rand() % 4 == 0) heaters.setPower(std::rand() % heatersNum, std::rand() % 101);
+
+        if(frame < 1000 && frame % 170 == 0) {
+            heaters.setPowers(batch, frame % 340 ? PowersCommit::NEXT_FRAME : PowersCommit::NEXT_SECOND);
+        }
+
+        heaters.zeroCrossed();
+    }
+
+    // Запись не обращается к распределителю памяти
+    ASSERT_EQ(getAllocationsCount(), before);
+
+    EventRecorder& recorder = heaters.getRecorder();
+    recorder.flush();
+
+    ASSERT_FALSE(recorder.isOverflowed());
+    ASSERT_EQ(recorder.getFrameIndex(), 1050u);
+
+    ReplayReport report = replayRecording(recorder.getData(), recorder.getSize());
+
+    ASSERT_TRUE(report.valid);
+    ASSERT_EQ(report.frames, 1050u);
+    ASSERT_EQ(report.checkpoints, 10u);
+    ASSERT_EQ(report.mismatches, 0u);
+    // Свёртка передаёт приёмнику активные слова
+    ASSERT_EQ(sink.activeCalls, 1050u);
+    ASSERT_EQ(sink.calls, 0u);
+
+    const std::string path = testing::TempDir() + "heaters_recording_test.bin";
+    std::vector<unsigned char> loaded;
+
+    ASSERT_TRUE(recorder.save(path));
+    ASSERT_TRUE(loadRecording(path, loaded));
+    ASSERT_EQ(loaded, std::vector<unsigned char>(recorder.getData(), recorder.getData() + recorder.getSize()));
+
+    std::remove(path.c_str());
+
+    // Запись заканчивается контрольной точкой и 50 переходами через ноль после неё
+    std::vector<unsigned char> data(recorder.getData(), recorder.getData() + recorder.getSize());
+
+    ASSERT_EQ(data[data.size() - 2], static_cast<unsigned char>(RecordedEvent::ZERO_CROSSED));
+    ASSERT_EQ(data[data.size() - 19], static_cast<unsigned char>(RecordedEvent::CHECKPOINT));
+
+    data[data.size() - 3] ^= 1u;
+
+    report = replayRecording(data.data(), data.size());
+
+    ASSERT_TRUE(report.valid);
+    ASSERT_GT(report.mismatches, 0u);
+
+    // Обрезанная запись некорректна
+    report = replayRecording(recorder.getData(), recorder.getSize() - 3);
+
+    ASSERT_FALSE(report.valid);
+    ASSERT_LT(report.errorOffset, recorder.getSize());
+
+    // Слишком большое количество переходов через ноль отклоняется без воспроизведения
+    data.resize(data.size() - 1);
+    data.insert(data.end(), {0xff, 0xff, 0xff, 0xff, 0xff, 0x01});
+
+    report = replayRecording(data.data(), data.size());
+
+    ASSERT_FALSE(report.valid);
+    ASSERT_EQ(report.errorOffset, recorder.getSize() - 2);
+}
+
+TEST(Allocations, steady_state_does_not_touch_allocator) {
+    const HeaterNum heatersNum = 150;
+    std::vector<HeaterNum> turnedOn(heatersNum, 0);
+    Heaters heaters(heatersNum, [&turnedOn](HeaterNum heater, bool state) {
+        turnedOn[heater] += state;
+    }, ScheduleLayout::BALANCED);
+
+    HeaterPowers batch = {{1, 40}, {7, 90}, {100, 15}};
+    HeaterPowers candidates = {{3, 20}, {140, 100}, {0, 0}};
+    std::vector<HeaterNum> budgetHeaters = {2, 4, 6};
+    std::vector<std::pair<HeaterNum, HeaterNum>> peaks;
+    HeaterPowers budget;
+
+    GroupMemberships memberships(heatersNum);
+    std::vector<HeaterNum> groupPeaks;
+
+    for(HeaterNum heater = 0; heater < heatersNum; ++heater) {
+        memberships[heater] = {static_cast<GroupNum>(heater % 3), static_cast<GroupNum>(3 + heater % 2)};
+    }
+
+    ASSERT_TRUE(heaters.setLoadGroups(5, memberships));
+
+    peaks.reserve(candidates.size());
+    budget.reserve(budgetHeaters.size());
+    groupPeaks.reserve(5);
+
+    std::size_t before = getAllocationsCount();
+    unsigned int top = 0;
+    unsigned int bot = 0;
+    Power power = 0;
+    std::uint32_t checksum = 0;
+
+    std::srand(43);
+    for(int frame = 0; frame < 1000; ++frame) {
+        heaters.setPower(std::rand() % heatersNum, std::rand() % 101);
+
+        if(frame % 50 == 0) {
+            heaters.setPowers(batch, frame % 100 ? PowersCommit::NEXT_FRAME : PowersCommit::NEXT_SECOND);
+        }
+
+        heaters.zeroCrossed();
+
+        heaters.getMaxNumOfTurnedHeatersAfterPowerChange(std::rand() % heatersNum, 50, top, bot);
+        heaters.getMaxNumOfTurnedHeatersAfterPowerChanges(candidates, peaks);
+        heaters.getMaxAdmissiblePower(std::rand() % heatersNum, 40, 40, power);
+        heaters.distributePowerBudget(budgetHeaters, 120, 40, 40, budget);
+        heaters.getMaxNumOfTurnedHeatersInGroups(groupPeaks);
+        heaters.getMaxNumOfTurnedHeatersInGroupsAfterPowerChange(std::rand() % heatersNum, 70, groupPeaks);
+
+        checksum += heaters.getPower(5, 3) + heaters.getPowerSum(5, 0, 9) + heaters.getMinPower(5, 0, 9) +
+                    heaters.getMaxPower(5, 0, 9) + heaters.getLastSemiPeriodState(5) +
+                    heaters.getPowerAggregate(5, 700).sum + top + bot + power + peaks[0].first + groupPeaks[0];
+    }
+
+    ASSERT_EQ(getAllocationsCount(), before);
+    ASSERT_GT(checksum, 0u);
+}
@@ -0,0 +1,75 @@
+#include "gtest/gtest.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "heaters.h"
+#include "static_heaters.h"
+
+/**
+ * Результаты совпадают с Heaters для той же последовательности вызовов
+ */
+TEST(StaticHeaters, matches_dynamic_heaters) {
+    std::vector<bool> dynamicStates(70, false);
+    std::vector<bool> staticStates(70, false);
+
+    auto staticSetter = [&staticStates](int num, bool state) { staticStates[num] = state; };
+
+    Heaters dynamicHeaters(70, [&dynamicStates](int num, bool state) { dynamicStates[num] = state; });
+    StaticHeaters<70, 100> staticHeaters(staticSetter);
+
+    std::srand(5);
+    for(int i = 0; i < 3000; ++i) {
+        if(i % 37 == 0) {
+            HeaterNum heater = std::rand() % 70;
+            Power power = std::rand() % 101;
+
+            dynamicHeaters.setPower(heater, power);
+            staticHeaters.setPower(heater, power);
+
+            unsigned int dynamicTop = 0, dynamicBot = 0, staticTop = 0, staticBot = 0;
+            dynamicHeaters.getMaxNumOfTurnedHeatersAfterPowerChange(0, 50, dynamicTop, dynamicBot);
+            staticHeaters.getMaxNumOfTurnedHeatersAfterPowerChange(0, 50, staticTop, staticBot);
+
+            ASSERT_EQ(staticTop, dynamicTop);
+            ASSERT_EQ(staticBot, dynamicBot);
+        }
+
+        dynamicHeaters.zeroCrossed();
+        staticHeaters.zeroCrossed();
+
+        ASSERT_EQ(staticStates, dynamicStates);
+    }
+
+    for(HeaterNum heater = 0; heater < 70; ++heater) {
+        for(unsigned short offset = 0; offset < 30; ++offset) {
+            ASSERT_EQ(staticHeaters.getPower(heater, offset), dynamicHeaters.getPower(heater, offset));
+        }
+    }
+}
+
+
+/**
+ * При частоте сети 60Гц мощность в процентах переводится в 120 полупериодов
+ */
+TEST(StaticHeaters, power_50_is_60_of_120_semi_periods_at_60_hz) {
+    bool heater_state = false;
+
+    // Функция без захвата получает состояние через контекст
+    StaticHeaters<1, 120> heaters([](void* context, HeaterNum, bool state) {
+        *static_cast<bool*>(context) = state;
+    }, &heater_state);
+
+    heaters.setPower(0, 50);
+
+    Power p = 0;
+    for(int i = 0; i < 120; ++i) {
+        heaters.zeroCrossed();
+        if(heater_state) {
+            ++p;
+        }
+    }
+
+    ASSERT_EQ(p, 60);
+    ASSERT_EQ(heaters.getPower(0), 50);
+}